@@ -0,0 +1,279 @@
+// gorilla_bench.cpp - created by Radek Brich on 2026-10-19
+
+// Benchmark of the sample history codec (src/Gorilla.h): bytes per sample
+// and encode / decode time on modelled sensor traces, compared to the line
+// protocol the device sends now. Every trace is checked to decode losslessly.
+//
+// Build and run:
+//   pio run -e gorilla_bench
+//   .pio/build/gorilla_bench/program [--days N] [--block BYTES]
+//
+// The traces are generated, with the resolution of the sensor drivers:
+// slow daily wave + random walk + noise, quantized like the raw readings,
+// then converted to float the same way as in Sensor.cpp. Timestamps
+// follow the sampling interval with an occasional +-1 s shift.
+
+#include "Gorilla.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Sample {
+    uint32_t time;
+    float value;
+};
+
+struct Trace {
+    std::string name;
+    std::string line_prefix;    // line protocol before the value
+    std::vector<Sample> samples;
+};
+
+constexpr uint32_t start_time = 1790000000;
+constexpr double pi = 3.14159265358979323846;
+
+
+// Timestamps with `interval` seconds, shifted by a second now and then
+// (report cycle drift), `value(t)` gives the sample
+Trace generate(const std::string& name, const std::string& line_prefix,
+               uint32_t interval, int days, std::mt19937& rng,
+               const std::function<float(uint32_t)>& value)
+{
+    Trace trace{name, line_prefix, {}};
+    std::uniform_int_distribution<int> jitter(0, 19);
+    uint32_t n = uint32_t(days) * 86400 / interval;
+    for (uint32_t i = 0; i != n; ++i) {
+        uint32_t t = start_time + i * interval;
+        int j = jitter(rng);
+        if (j == 0) --t;
+        if (j == 1) ++t;
+        trace.samples.push_back({t, value(t)});
+    }
+    return trace;
+}
+
+
+// Daily wave + random walk + gaussian noise
+class Signal {
+public:
+    Signal(double mean, double amplitude, double walk, double noise, std::mt19937& rng)
+        : m_mean(mean), m_amplitude(amplitude), m_walk(walk), m_noise(noise), m_rng(rng) {}
+
+    double operator()(uint32_t t) {
+        m_offset += m_walk * m_normal(m_rng);
+        double day = std::sin(2 * pi * ((t - start_time) % 86400) / 86400.0);
+        return m_mean + m_amplitude * day + m_offset + m_noise * m_normal(m_rng);
+    }
+
+private:
+    double m_mean, m_amplitude, m_walk, m_noise;
+    double m_offset = 0;
+    std::mt19937& m_rng;
+    std::normal_distribution<double> m_normal;
+};
+
+
+std::vector<Trace> make_traces(int days)
+{
+    std::mt19937 rng(42);
+    std::vector<Trace> traces;
+    const std::string tags = ",device=ufo1,location=kitchen value=";
+
+    // SHT30: 16-bit raw readings, repeatability ~0.04 C / 0.1 %RH
+    Signal sht_temp(22.0, 1.5, 0.002, 0.02, rng);
+    traces.push_back(generate("SHT30 temperature", "temperature,sensor=SHT30" + tags,
+                              10, days, rng, [&](uint32_t t) {
+        auto raw = uint16_t(std::lround((sht_temp(t) + 45.0) * 65535.0 / 175.0));
+        return -45.f + 175.f * float(raw) / 65535.f;
+    }));
+    Signal sht_hum(45.0, 5.0, 0.01, 0.08, rng);
+    traces.push_back(generate("SHT30 humidity", "humidity,sensor=SHT30" + tags,
+                              10, days, rng, [&](uint32_t t) {
+        auto raw = uint16_t(std::lround(sht_hum(t) * 65535.0 / 100.0));
+        return 100.f * float(raw) / 65535.f;
+    }));
+
+    // BMP280: the driver computes in double from 20-bit readings,
+    // resolution ~0.005 C and ~0.016 hPa (no oversampling)
+    Signal bmp_temp(22.6, 1.5, 0.002, 0.01, rng);
+    traces.push_back(generate("BMP280 temperature", "temperature,sensor=BMP280" + tags,
+                              10, days, rng, [&](uint32_t t) {
+        double raw = std::round(bmp_temp(t) / 0.005);
+        return float(raw * 0.005);
+    }));
+    Signal bmp_press(1013.0, 1.0, 0.003, 0.02, rng);
+    traces.push_back(generate("BMP280 pressure", "pressure,sensor=BMP280" + tags,
+                              10, days, rng, [&](uint32_t t) {
+        double raw = std::round(bmp_press(t) / 0.016);
+        return float(raw * 0.016);
+    }));
+
+    // DS18B20: 12-bit, steps of 1/16 C - exact in float
+    Signal dallas(18.0, 1.0, 0.002, 0.03, rng);
+    traces.push_back(generate("Dallas temperature", "temperature,sensor=Dallas" + tags,
+                              30, days, rng, [&](uint32_t t) {
+        return float(std::round(dallas(t) * 16.0) / 16.0);
+    }));
+
+    // Moisture digital output: mostly constant
+    std::bernoulli_distribution flip(0.001);
+    bool wet = false;
+    traces.push_back(generate("moisture (digital)", "moisture_digital,sensor=Moist" + tags,
+                              1, days, rng, [&](uint32_t) {
+        if (flip(rng))
+            wet = !wet;
+        return wet ? 1.f : 0.f;
+    }));
+    return traces;
+}
+
+
+// As the device prints it: Print::print(float) with 2 decimal places
+size_t line_protocol_size(const Trace& trace)
+{
+    size_t size = 0;
+    char buf[32];
+    for (const Sample& s : trace.samples)
+        size += trace.line_prefix.size() + snprintf(buf, sizeof(buf), "%.2f\n", s.value);
+    return size;
+}
+
+
+// Whole trace in blocks of `block_size`, returns the blocks
+std::vector<std::vector<uint8_t>> encode(const Trace& trace, size_t block_size)
+{
+    std::vector<std::vector<uint8_t>> blocks;
+    std::vector<uint8_t> buffer(block_size);
+    gorilla::Encoder encoder(buffer.data(), buffer.size());
+    for (const Sample& s : trace.samples) {
+        if (encoder.append(s.time, s.value))
+            continue;
+        blocks.emplace_back(encoder.data(), encoder.data() + encoder.size());
+        encoder.reset();
+        if (!encoder.append(s.time, s.value)) {
+            fprintf(stderr, "Block too small\n");
+            exit(1);
+        }
+    }
+    if (encoder.count() != 0)
+        blocks.emplace_back(encoder.data(), encoder.data() + encoder.size());
+    return blocks;
+}
+
+
+bool check(const Trace& trace, const std::vector<std::vector<uint8_t>>& blocks)
+{
+    size_t i = 0;
+    for (const auto& block : blocks) {
+        gorilla::Decoder decoder(block.data(), block.size());
+        uint32_t time;
+        float value;
+        while (decoder.next(time, value)) {
+            if (i == trace.samples.size() || time != trace.samples[i].time
+                    || memcmp(&value, &trace.samples[i].value, sizeof(value)) != 0)
+                return false;
+            ++i;
+        }
+    }
+    return i == trace.samples.size();
+}
+
+
+template <class F>
+double ns_per_sample(const Trace& trace, F&& fn)
+{
+    using clock = std::chrono::steady_clock;
+    // Repeat for at least 0.2 s, take the best of 5 runs
+    double best = 0;
+    for (int run = 0; run != 5; ++run) {
+        size_t n = 0;
+        auto start = clock::now();
+        std::chrono::duration<double, std::nano> elapsed{};
+        do {
+            fn();
+            n += trace.samples.size();
+            elapsed = clock::now() - start;
+        } while (elapsed.count() < 0.2e9 / 5);
+        double ns = elapsed.count() / double(n);
+        if (run == 0 || ns < best)
+            best = ns;
+    }
+    return best;
+}
+
+
+} // namespace
+
+
+int main(int argc, char* argv[])
+{
+    int days = 1;
+    size_t block_size = 256;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--days") == 0 && i + 1 < argc)
+            days = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--block") == 0 && i + 1 < argc)
+            block_size = size_t(atoi(argv[++i]));
+        else {
+            fprintf(stderr, "Usage: %s [--days N] [--block BYTES]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (days < 1 || block_size < gorilla::header_size + 8) {
+        fprintf(stderr, "Invalid arguments\n");
+        return 2;
+    }
+
+    printf("%d day(s), blocks of %zu bytes\n\n", days, block_size);
+    printf("%-20s %8s %8s %9s %9s %9s %9s\n", "trace", "samples", "bytes",
+           "B/sample", "LP B/smp", "enc ns", "dec ns");
+
+    bool ok = true;
+    for (const Trace& trace : make_traces(days)) {
+        auto blocks = encode(trace, block_size);
+        size_t bytes = 0;
+        for (const auto& block : blocks)
+            bytes += block.size();
+        if (!check(trace, blocks)) {
+            printf("%-20s DECODE MISMATCH\n", trace.name.c_str());
+            ok = false;
+            continue;
+        }
+
+        std::vector<uint8_t> buffer(block_size);
+        double enc = ns_per_sample(trace, [&] {
+            gorilla::Encoder encoder(buffer.data(), buffer.size());
+            for (const Sample& s : trace.samples) {
+                if (!encoder.append(s.time, s.value)) {
+                    encoder.reset();
+                    encoder.append(s.time, s.value);
+                }
+            }
+        });
+        volatile uint32_t sink = 0;
+        double dec = ns_per_sample(trace, [&] {
+            for (const auto& block : blocks) {
+                gorilla::Decoder decoder(block.data(), block.size());
+                uint32_t time;
+                float value;
+                while (decoder.next(time, value))
+                    sink = sink + time;
+            }
+        });
+
+        size_t n = trace.samples.size();
+        printf("%-20s %8zu %8zu %9.2f %9.2f %9.1f %9.1f\n", trace.name.c_str(), n, bytes,
+               double(bytes) / n, double(line_protocol_size(trace)) / n, enc, dec);
+    }
+    printf("\nB/sample: compressed incl. block headers, LP B/smp: line protocol,\n"
+           "enc / dec ns: time per sample on this machine\n");
+    return ok ? 0 : 1;
+}
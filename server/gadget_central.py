@@ -3,9 +3,180 @@
 import bottle
 import argparse
 import os
+import threading
+import time
+import urllib.error
+import urllib.parse
+import urllib.request
+
+import gorilla
 
 app = bottle.Bottle()
 script_dir = os.path.dirname(__file__)
+influxdb_url = 'http://127.0.0.1:8087'  # --influxdb
+
+
+class CommandCache:
+    """Command sets of the devices (commands/<device>/seq, commands/<device>/<seq>)
+
+    Kept in memory. A lookup only stats the device directory and the two files,
+    they are read again when one of them changes (new seq, new or edited
+    command file, acknowledged file removed).
+    """
+
+    def __init__(self, root):
+        self.root = root
+        self.entries = {}  # device -> (stamp, seq, commands)
+        self.lock = threading.Lock()  # MqttCommands runs in its own thread
+
+    @staticmethod
+    def _mtime(path):
+        try:
+            return os.stat(path).st_mtime_ns
+        except OSError:
+            return None
+
+    def get(self, device):
+        """Returns (seq, commands): seq is None for unknown device,
+        commands is None when there are none for the seq"""
+        with self.lock:
+            return self._get(device)
+
+    def devices(self):
+        try:
+            return [d for d in os.listdir(self.root) if os.path.isdir(os.path.join(self.root, d))]
+        except OSError:
+            return []
+
+    def _get(self, device):
+        device_dir = os.path.join(self.root, device)
+        entry = self.entries.get(device)
+        if entry is not None:
+            stamp, seq, commands = entry
+            if stamp == (self._mtime(device_dir), self._mtime(device_dir + '/seq'),
+                         self._mtime(device_dir + '/' + seq)):
+                return seq, commands
+        try:
+            stamp_dir = self._mtime(device_dir)
+            stamp_seq = self._mtime(device_dir + '/seq')
+            with open(device_dir + '/seq') as f:
+                seq = f.readline().strip()
+        except OSError:
+            self.entries.pop(device, None)
+            return None, None
+        stamp_commands = self._mtime(device_dir + '/' + seq)
+        try:
+            with open(device_dir + '/' + seq) as f:
+                commands = f.read()
+        except OSError:
+            commands = None
+        self.entries[device] = ((stamp_dir, stamp_seq, stamp_commands), seq, commands)
+        return seq, commands
+
+
+commands_cache = CommandCache(os.path.join(script_dir, 'commands'))
+
+
+def acknowledge(device, seq):
+    """Remove commands applied by the device"""
+    if not seq.isdigit():
+        return False
+    try:
+        os.unlink(os.path.join(commands_cache.root, device, seq))
+    except OSError:
+        return False
+    return True
+
+
+class MqttCommands:
+    """Commands for devices built WITH_MQTT (src/MqttClient.h)
+
+    A new command set is published to <prefix>/<device>/control/<seq> (QoS 1),
+    the broker keeps it in the device's persistent session while it's offline.
+    The device acknowledges it in <prefix>/<device>/ack, the file is removed then.
+    Needs paho-mqtt.
+    """
+
+    def __init__(self, broker, prefix, interval=2.0):
+        import paho.mqtt.client as mqtt
+        host, _, port = broker.partition(':')
+        self.prefix = prefix
+        self.interval = interval
+        self.published = {}  # device -> seq
+        self.client = mqtt.Client(client_id='gadget_central')
+        self.client.on_connect = self.on_connect
+        self.client.on_message = self.on_message
+        self.client.connect_async(host, int(port or 1883))
+
+    def start(self):
+        self.client.loop_start()
+        threading.Thread(target=self.run, daemon=True).start()
+
+    def on_connect(self, client, userdata, flags, rc):
+        client.subscribe(self.prefix + '/+/ack', qos=1)
+        # publish again after reconnect, QoS 1 may repeat anyway
+        self.published.clear()
+
+    def on_message(self, client, userdata, msg):
+        # <prefix>/<device>/ack
+        device = msg.topic[len(self.prefix) + 1:].split('/')[0]
+        acknowledge(device, msg.payload.decode(errors='replace').strip())
+
+    def run(self):
+        while True:
+            if self.client.is_connected():
+                for device in commands_cache.devices():
+                    seq, commands = commands_cache.get(device)
+                    if seq is None or commands is None or self.published.get(device) == seq:
+                        continue
+                    topic = '%s/%s/control/%s' % (self.prefix, device, seq)
+                    self.client.publish(topic, commands, qos=1)
+                    self.published[device] = seq
+            time.sleep(self.interval)
+
+
+def influx_write(db, data, precision=None):
+    """Forward line protocol to InfluxDB /write, abort with 502 when it fails
+
+    The data of a failed request are lost: the device doesn't buffer them,
+    it only keeps the report due and sends its current values at the next
+    attempt. The error status keeps the commands unacknowledged, and keeps
+    pending alerts on the device until they are stored.
+    """
+    if not db:
+        bottle.abort(400, "Missing db.")
+    if not data.strip() or not influxdb_url:
+        return  # nothing to store, or --influxdb '' (load tests)
+    query = {'db': db}
+    if precision:
+        query['precision'] = precision
+    url = influxdb_url + '/write?' + urllib.parse.urlencode(query)
+    if isinstance(data, str):
+        data = data.encode()
+    try:
+        with urllib.request.urlopen(urllib.request.Request(url, data=data, method='POST'), timeout=10):
+            pass
+    except urllib.error.HTTPError as e:
+        bottle.abort(502, "InfluxDB: %d %s" % (e.code, e.read().decode(errors='replace').strip()))
+    except OSError as e:
+        bottle.abort(502, "InfluxDB: %s" % e)
+
+
+def line_protocol_key(name, measurement=False):
+    """Escape measurement, tag key or tag value for line protocol, abort with 400 when invalid"""
+    if not name or '\\' in name or any(c < ' ' for c in name):
+        bottle.abort(400, "Invalid name: %r" % name)
+    name = name.replace(',', '\\,').replace(' ', '\\ ')
+    return name if measurement else name.replace('=', '\\=')
+
+
+def etag_matches(etag):
+    """Request header If-None-Match contains `etag`"""
+    header = bottle.request.get_header('If-None-Match')
+    if not header:
+        return False
+    tags = [t.strip() for t in header.split(',')]
+    return '*' in tags or etag in tags or 'W/' + etag in tags
 
 
 @app.route('/')
@@ -23,24 +194,27 @@ def update(device):
 
 @app.route('/control/<device>')
 def control(device):
-    """Get commands for the device"""
+    """Get commands for the device
+
+    ETag is the seq. A device sends the seq it has in If-None-Match
+    and gets 304 Not Modified (no body) until there's a new one.
+    """
     bottle.response.content_type = 'text/plain; charset=UTF-8'
     bottle.response.set_header('X-Device', device)
 
-    try:
-        with open(script_dir + '/commands/' + device + '/seq') as f:
-            seq = f.readline().strip()
-    except:
+    seq, commands = commands_cache.get(device)
+    if seq is None:
         bottle.abort(404, "Device not known: " + device)
-    try:
-        with open(script_dir + '/commands/' + device + '/' + seq) as f:
-            commands = f.read()
-    except:
-        bottle.abort(404, "No commands for device: " + device)
 
     # Sequence number, this is incremented with each new command set
     # The device reads current Seq on startup, then checks for a change.
     # Whenever the number changes, the device executes the commands.
+    etag = '"%s"' % seq
+    if etag_matches(etag):
+        return bottle.HTTPResponse(status=304, headers={'ETag': etag, 'X-Device': device})
+    if commands is None:
+        bottle.abort(404, "No commands for device: " + device)
+    bottle.response.set_header('ETag', etag)
     bottle.response.set_header('X-Seq', seq)
     return commands
 
@@ -48,19 +222,76 @@ def control(device):
 @app.route('/control/<device>', method='DELETE')
 def control(device):
     """Acknowledge processing of commands"""
-    seq = bottle.request.query.seq
-    try:
-        os.unlink(script_dir + '/commands/' + device + '/' + seq)
-    except OSError:
+    if not acknowledge(device, bottle.request.query.seq):
         bottle.abort(404, "No commands found.")
     return 'ACK'
 
 
 @app.route('/write', method='POST')
 def write():
-    """Forward sensor data to InfluxDB"""
-    db = bottle.request.forms.get('db')
-    return "Not implemented."
+    """Forward sensor data to InfluxDB (query: db, like InfluxDB /write)"""
+    influx_write(bottle.request.query.db, bottle.request.body.read())
+    return bottle.HTTPResponse(status=204)
+
+
+@app.route('/report/<device>', method='POST')
+def report(device):
+    """Sensor data + command ack + new commands, in one round trip
+
+    Query: db (InfluxDB database), seq (last commands applied by the device, -1 for none).
+    Commands with that seq are acknowledged (removed), commands with a newer seq
+    are returned. A device keeps getting them until it reports the new seq back.
+    """
+    influx_write(bottle.request.query.db, bottle.request.body.read())
+
+    bottle.response.content_type = 'text/plain; charset=UTF-8'
+    bottle.response.set_header('X-Device', device)
+    acked = bottle.request.query.seq
+    acknowledge(device, acked)
+
+    seq, commands = commands_cache.get(device)
+    if seq is None:
+        return ''  # no commands for unknown device, data are accepted anyway
+    bottle.response.set_header('X-Seq', seq)
+    if seq == acked or commands is None:
+        return ''  # acknowledged now, or before (e.g. by DELETE)
+    return commands
+
+
+@app.route('/history/<device>', method='POST')
+def history(device):
+    """Buffered samples of one series, compressed (see gorilla.py)
+
+    Query: db (InfluxDB database), measurement, sensor, tags (DEVICE_TAGS
+    of the device, e.g. device=ufo1,location=kitchen - the points join
+    the series of its reports; default: device=<device>).
+    Body: one history block. Returns the samples as line protocol
+    (precision: seconds).
+    """
+    db = bottle.request.query.db
+    measurement = bottle.request.query.measurement
+    sensor = bottle.request.query.sensor
+    if not measurement or not sensor:
+        bottle.abort(400, "Missing measurement or sensor.")
+    tags = [('sensor', sensor)]
+    for pair in (bottle.request.query.tags or 'device=' + device).split(','):
+        key, eq, value = pair.partition('=')
+        if not eq or key == 'sensor':
+            bottle.abort(400, "Invalid tags.")
+        tags.append((key, value))
+    series = ','.join([line_protocol_key(measurement, measurement=True)]
+                      + ['%s=%s' % (line_protocol_key(k), line_protocol_key(v)) for k, v in tags])
+    try:
+        samples = gorilla.decode(bottle.request.body.read())
+    except ValueError as e:
+        bottle.abort(400, str(e))
+    data = ''.join('%s value=%r %d\n' % (series, value, time)
+                   for time, value in samples)
+    influx_write(db, data, precision='s')
+
+    bottle.response.content_type = 'text/plain; charset=UTF-8'
+    bottle.response.set_header('X-Device', device)
+    return data
 
 
 @app.error(404)
@@ -73,7 +304,13 @@ if __name__ == '__main__':
     ap.add_argument('--debug', action='store_true', help='debug mode')
     ap.add_argument('--reload', action='store_true', help='auto-reload')
     ap.add_argument('--host', default='0.0.0.0', help='bind address')
-    ap.add_argument('--port', default=8086, help='bind port')
+    ap.add_argument('--port', type=int, default=8086, help='bind port')
+    ap.add_argument('--influxdb', default=influxdb_url, help="InfluxDB URL, sensor data are forwarded there ('' = drop them)")
+    ap.add_argument('--mqtt', metavar='HOST[:PORT]', help='MQTT broker, publish commands for WITH_MQTT devices')
+    ap.add_argument('--mqtt-prefix', default='gadgets', help='MQTT topic prefix (before device name)')
     args = ap.parse_args()
     bottle.debug(args.debug)
+    influxdb_url = args.influxdb.rstrip('/')
+    if args.mqtt and (not args.reload or os.environ.get('BOTTLE_CHILD')):
+        MqttCommands(args.mqtt, args.mqtt_prefix).start()
     bottle.run(app, host=args.host, port=args.port, reloader=args.reload)
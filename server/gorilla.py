@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+
+# Decoder of sample history blocks from devices (src/Gorilla.h).
+# Block format is described there.
+#
+# Usage: gorilla.py <block file> - prints the samples
+
+import struct
+import sys
+
+VERSION = 1
+HEADER_SIZE = 3
+
+
+class BitReader:
+
+    def __init__(self, data, pos):
+        self.data = data
+        self.pos = pos  # in bits
+
+    def read(self, bits):
+        value = 0
+        for _ in range(bits):
+            byte = self.pos // 8
+            if byte >= len(self.data):
+                raise ValueError("Truncated block")
+            value = value << 1 | (self.data[byte] >> (7 - self.pos % 8)) & 1
+            self.pos += 1
+        return value
+
+
+def decode(block):
+    """Decode one block, returns list of (time, value)"""
+    if len(block) < HEADER_SIZE or block[0] != VERSION:
+        raise ValueError("Not a history block (version %d)" % VERSION)
+    count = block[1] | block[2] << 8
+    bits = BitReader(block, HEADER_SIZE * 8)
+    samples = []
+    time = delta = raw = 0
+    leading = trailing = 0
+    for i in range(count):
+        if i == 0:
+            time = bits.read(32)
+            raw = bits.read(32)
+        else:
+            if bits.read(1) == 0:
+                dod = 0
+            elif bits.read(1) == 0:
+                dod = bits.read(7) - 63
+            elif bits.read(1) == 0:
+                dod = bits.read(9) - 255
+            elif bits.read(1) == 0:
+                dod = bits.read(12) - 2047
+            else:
+                dod = bits.read(32)
+            # 32-bit wrap-around, as on the device
+            delta = (delta + dod) & 0xffffffff
+            time = (time + delta) & 0xffffffff
+            if bits.read(1) == 1:
+                if bits.read(1) == 1:
+                    leading = bits.read(5)
+                    length = bits.read(5) + 1
+                    if leading + length > 32:
+                        raise ValueError("Corrupted block")
+                    trailing = 32 - leading - length
+                raw ^= bits.read(32 - leading - trailing) << trailing
+        value, = struct.unpack('<f', struct.pack('<I', raw))
+        samples.append((time, value))
+    return samples
+
+
+if __name__ == '__main__':
+    with open(sys.argv[1], 'rb') as f:
+        for time, value in decode(f.read()):
+            print(time, repr(value))
@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+"""Local TCP port -> RFC 2217 port of wifi_serial, resets the target on connect.
+
+avrdude can't talk RFC 2217, but it can use a raw TCP port (`-P net:host:port`).
+Each connection to the local port opens the remote serial port with DTR asserted,
+which pulses the reset line (RESET_PIN), the bootloader then gets the data.
+
+    ./server/rfc2217_bridge.py wifi-serial.lan --baud 115200 &
+    avrdude -c arduino -p atmega328p -P net:127.0.0.1:2323 -U flash:w:firmware.hex
+
+Requires pyserial.
+"""
+
+import argparse
+import socket
+import threading
+
+import serial
+
+
+def serial_to_socket(port, conn, stop):
+    while not stop.is_set():
+        data = port.read(port.in_waiting or 1)
+        if data:
+            conn.sendall(data)
+
+
+def bridge(conn, url, baud):
+    port = serial.serial_for_url(url, baudrate=baud, timeout=0.1)
+    stop = threading.Event()
+    reader = threading.Thread(target=serial_to_socket, args=(port, conn, stop), daemon=True)
+    reader.start()
+    try:
+        while True:
+            data = conn.recv(4096)
+            if not data:
+                break
+            port.write(data)
+    finally:
+        stop.set()
+        reader.join()
+        port.close()
+        conn.close()
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument('host', help='wifi_serial device')
+    ap.add_argument('--port', type=int, default=2217, help='RFC 2217 port of the device')
+    ap.add_argument('--baud', type=int, default=115200, help='baud rate of the target bootloader')
+    ap.add_argument('--listen', type=int, default=2323, help='local port for avrdude')
+    args = ap.parse_args()
+
+    url = 'rfc2217://%s:%d' % (args.host, args.port)
+    server = socket.create_server(('127.0.0.1', args.listen))
+    print('Listening on 127.0.0.1:%d -> %s (%d baud)' % (args.listen, url, args.baud))
+    while True:
+        conn, _ = server.accept()
+        conn.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        try:
+            bridge(conn, url, args.baud)
+        except (OSError, serial.SerialException) as e:
+            print('Error:', e)
+
+
+if __name__ == '__main__':
+    main()
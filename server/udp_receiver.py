@@ -0,0 +1,39 @@
+#!/usr/bin/env python3
+
+# Local stand-in for InfluxDB UDP listener.
+# Prints received line protocol, one datagram at a time.
+
+import argparse
+import socket
+import time
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument('--host', default='0.0.0.0', help='bind address')
+    ap.add_argument('--port', type=int, default=8089, help='bind port')
+    args = ap.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind((args.host, args.port))
+    print("Listening on %s:%d (UDP)" % (args.host, args.port))
+
+    packets = 0
+    lines = 0
+    while True:
+        data, addr = sock.recvfrom(65535)
+        packets += 1
+        text = data.decode('utf-8', errors='replace')
+        n = text.count('\n')
+        lines += n
+        print("[%s] %s:%d - %d bytes, %d lines (total %d packets, %d lines)"
+              % (time.strftime('%H:%M:%S'), addr[0], addr[1], len(data), n, packets, lines))
+        for line in text.splitlines():
+            print("  " + line)
+
+
+if __name__ == '__main__':
+    try:
+        main()
+    except KeyboardInterrupt:
+        pass
@@ -0,0 +1,301 @@
+// Arduino.cpp - created by Radek Brich on 2026-10-19
+// Arduino core for the host build: String, Print, Stream, Serial, time
+
+#include "Arduino.h"
+#include "Replay.h"
+#include "Sim.h"
+#include <cstdarg>
+#include <poll.h>
+#include <thread>
+
+using namespace sim;
+
+// -----------------------------------------------------------------------------
+// String
+
+static std::string format_number(unsigned long value, unsigned char base)
+{
+    if (value == 0)
+        return "0";
+    std::string result;
+    while (value != 0) {
+        auto digit = char(value % base);
+        result.insert(result.begin(), char(digit < 10 ? '0' + digit : 'a' + digit - 10));
+        value /= base;
+    }
+    return result;
+}
+
+static std::string format_signed(long value, unsigned char base)
+{
+    if (value < 0 && base == 10)
+        return "-" + format_number((unsigned long) -value, base);
+    return format_number((unsigned long) value, base);
+}
+
+String::String(int value, unsigned char base) : m_str(format_signed(value, base)) {}
+String::String(unsigned int value, unsigned char base) : m_str(format_number(value, base)) {}
+String::String(long value, unsigned char base) : m_str(format_signed(value, base)) {}
+String::String(unsigned long value, unsigned char base) : m_str(format_number(value, base)) {}
+String::String(float value, unsigned char decimal_places) : String(double(value), decimal_places) {}
+
+String::String(double value, unsigned char decimal_places)
+{
+    char buf[40];
+    snprintf(buf, sizeof(buf), "%.*f", decimal_places, value);
+    m_str = buf;
+}
+
+bool String::endsWith(const String& suffix) const
+{
+    return m_str.size() >= suffix.m_str.size()
+        && m_str.compare(m_str.size() - suffix.m_str.size(), std::string::npos, suffix.m_str) == 0;
+}
+
+int String::indexOf(char ch, unsigned int from) const
+{
+    auto pos = m_str.find(ch, from);
+    return pos == std::string::npos ? -1 : (int) pos;
+}
+
+int String::indexOf(const String& str, unsigned int from) const
+{
+    auto pos = m_str.find(str.m_str, from);
+    return pos == std::string::npos ? -1 : (int) pos;
+}
+
+int String::lastIndexOf(char ch) const
+{
+    auto pos = m_str.rfind(ch);
+    return pos == std::string::npos ? -1 : (int) pos;
+}
+
+String String::substring(unsigned int begin_index) const
+{
+    return substring(begin_index, length());
+}
+
+String String::substring(unsigned int begin_index, unsigned int end_index) const
+{
+    if (begin_index > end_index)
+        std::swap(begin_index, end_index);
+    end_index = std::min(end_index, length());
+    if (begin_index >= end_index)
+        return {};
+    String result;
+    result.m_str = m_str.substr(begin_index, end_index - begin_index);
+    return result;
+}
+
+void String::trim()
+{
+    auto begin = m_str.find_first_not_of(" \t\r\n\f\v");
+    if (begin == std::string::npos) {
+        m_str.clear();
+        return;
+    }
+    auto end = m_str.find_last_not_of(" \t\r\n\f\v");
+    m_str = m_str.substr(begin, end - begin + 1);
+}
+
+long String::toInt() const { return strtol(m_str.c_str(), nullptr, 10); }
+float String::toFloat() const { return strtof(m_str.c_str(), nullptr); }
+
+String operator +(const String& lhs, const String& rhs) { String r(lhs); r.concat(rhs); return r; }
+String operator +(const String& lhs, const char* rhs) { String r(lhs); r.concat(rhs); return r; }
+String operator +(const char* lhs, const String& rhs) { String r(lhs); r.concat(rhs); return r; }
+
+// -----------------------------------------------------------------------------
+// Print, Stream
+
+size_t Print::write(const uint8_t* buffer, size_t size)
+{
+    size_t n = 0;
+    while (size--)
+        n += write(*buffer++);
+    return n;
+}
+
+size_t Print::printf(const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    char buf[256];
+    int len = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    if (len < 0)
+        return 0;
+    if (size_t(len) < sizeof(buf))
+        return write((const uint8_t*) buf, len);
+    std::string big(len + 1, '\0');
+    va_start(args, format);
+    vsnprintf(&big[0], big.size(), format, args);
+    va_end(args);
+    return write((const uint8_t*) big.data(), len);
+}
+
+size_t Print::printf_P(const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    char buf[256];
+    int len = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    return len < 0 ? 0 : write((const uint8_t*) buf, std::min(size_t(len), sizeof(buf) - 1));
+}
+
+size_t Print::print(long n, int base) { return print(String(n, (unsigned char) base)); }
+size_t Print::print(unsigned long n, int base) { return print(String(n, (unsigned char) base)); }
+size_t Print::print(double n, int digits) { return print(String(n, (unsigned char) digits)); }
+
+// Stream timeouts are in real time, the virtual clock may run much faster
+int Stream::timedRead()
+{
+    auto deadline = Clock::now() + std::chrono::milliseconds(m_timeout);
+    do {
+        int c = read();
+        if (c >= 0)
+            return c;
+        yield();
+    } while (Clock::now() < deadline);
+    return -1;
+}
+
+size_t Stream::readBytes(char* buffer, size_t length)
+{
+    size_t count = 0;
+    while (count < length) {
+        int c = timedRead();
+        if (c < 0)
+            break;
+        buffer[count++] = (char) c;
+    }
+    return count;
+}
+
+size_t Stream::readBytesUntil(char terminator, char* buffer, size_t length)
+{
+    size_t count = 0;
+    while (count < length) {
+        int c = timedRead();
+        if (c < 0 || c == terminator)
+            break;
+        buffer[count++] = (char) c;
+    }
+    return count;
+}
+
+String Stream::readStringUntil(char terminator)
+{
+    String result;
+    int c = timedRead();
+    while (c >= 0 && c != terminator) {
+        result.concat((char) c);
+        c = timedRead();
+    }
+    return result;
+}
+
+// -----------------------------------------------------------------------------
+// Serial - line buffered per device, printed only in verbose mode
+
+HardwareSerial Serial;
+static std::mutex serial_mutex;
+
+size_t HardwareSerial::write(uint8_t c)
+{
+    if (!options.verbose || device == nullptr)
+        return 1;
+    if (c == '\n') {
+        std::lock_guard<std::mutex> lock(serial_mutex);
+        fprintf(stderr, "[%3d] %s\n", device->id, device->serial_line.c_str());
+        device->serial_line.clear();
+    } else if (c != '\r')
+        device->serial_line += char(c);
+    return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size)
+{
+    if (!options.verbose)
+        return size;
+    return Print::write(buffer, size);
+}
+
+void HardwareSerial::flush() {}
+
+// -----------------------------------------------------------------------------
+// Time - each device has its own virtual clock, running `speed` times faster
+// (or the clock of the replayed trace)
+
+unsigned long millis()
+{
+    if (device->replay != nullptr)
+        return device->replay->now();
+    std::chrono::duration<double, std::milli> real = Clock::now() - device->start;
+    return device->offset + (unsigned long) (real.count() * device->speed);
+}
+
+unsigned long micros()
+{
+    if (device->replay != nullptr)
+        return device->replay->now() * 1000;
+    std::chrono::duration<double, std::micro> real = Clock::now() - device->start;
+    return device->offset * 1000 + (unsigned long) (real.count() * device->speed);
+}
+
+void delay(unsigned long ms)
+{
+    if (device->replay != nullptr) {
+        device->replay->advance(ms);
+        return;
+    }
+    ms = std::max(ms, options.min_delay);
+    std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(ms / device->speed));
+}
+
+void delayMicroseconds(unsigned int us) {}
+
+// Wait for the socket which was last found empty, instead of spinning
+void yield()
+{
+    if (device != nullptr && device->replay != nullptr)
+        device->replay->wait();
+    else if (device != nullptr && device->wait_fd != -1) {
+        pollfd pfd {device->wait_fd, POLLIN, 0};
+        poll(&pfd, 1, 10);
+        device->wait_fd = -1;
+    } else
+        std::this_thread::yield();
+}
+
+// -----------------------------------------------------------------------------
+// Pins - nothing is connected
+
+void pinMode(uint8_t pin, uint8_t mode) {}
+void digitalWrite(uint8_t pin, uint8_t val) {}
+int digitalRead(uint8_t pin) { return LOW; }
+int analogRead(uint8_t pin) { return (int) random(1024); }
+void analogWrite(uint8_t pin, int val) {}
+void attachInterrupt(uint8_t pin, void (*handler)(), int mode) {}
+void detachInterrupt(uint8_t pin) {}
+
+// -----------------------------------------------------------------------------
+// Random
+
+long random(long max)
+{
+    if (max <= 0)
+        return 0;
+    return std::uniform_int_distribution<long>(0, max - 1)(device->rng);
+}
+
+long random(long min, long max)
+{
+    return min >= max ? min : min + random(max - min);
+}
+
+void randomSeed(unsigned long seed)
+{
+    device->rng.seed(seed);
+}
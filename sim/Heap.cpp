@@ -0,0 +1,47 @@
+// Heap.cpp - created by Radek Brich on 2026-10-19
+// Heap allocation counting for the host build: `sim::allocations`
+// (replay statistics) and heap_check (-DCHECK_HEAP).
+// Interposes malloc for the whole process, including libstdc++.
+
+#include "HeapCheck.h"
+#include "Sim.h"
+#include <cstddef>
+
+namespace sim {
+thread_local unsigned long allocations = 0;
+}
+
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_calloc(size_t nmemb, size_t size);
+
+void* malloc(size_t size)
+{
+    ++sim::allocations;
+#ifdef CHECK_HEAP
+    heap_check::on_alloc(size, __builtin_return_address(0));
+#endif
+    return __libc_malloc(size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    ++sim::allocations;
+#ifdef CHECK_HEAP
+    heap_check::on_alloc(size, __builtin_return_address(0));
+#endif
+    return __libc_realloc(ptr, size);
+}
+
+void* calloc(size_t nmemb, size_t size)
+{
+    ++sim::allocations;
+#ifdef CHECK_HEAP
+    heap_check::on_alloc(nmemb * size, __builtin_return_address(0));
+#endif
+    return __libc_calloc(nmemb, size);
+}
+
+} // extern "C"
@@ -0,0 +1,284 @@
+// Replay.cpp - created by Radek Brich on 2026-10-19
+
+#include "Replay.h"
+#include "Trace.h"
+#include <cstdio>
+#include <cstring>
+
+namespace sim {
+
+using trace::Record;
+
+
+// Reads the trace, throws nothing - `ok()` turns false on malformed data
+class Reader {
+public:
+    explicit Reader(const std::vector<uint8_t>& data) : m_data(data) {}
+
+    bool ok() const { return m_ok; }
+    bool done() const { return m_pos == m_data.size(); }
+    size_t pos() const { return m_pos; }
+
+    uint8_t byte() {
+        if (m_pos == m_data.size()) {
+            m_ok = false;
+            return 0;
+        }
+        return m_data[m_pos++];
+    }
+
+    unsigned long varint() {
+        unsigned long v = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            uint8_t b = byte();
+            v |= (unsigned long) (b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return v;
+        }
+        m_ok = false;
+        return v;
+    }
+
+    std::string bytes(size_t length) {
+        if (length > m_data.size() - m_pos) {
+            m_ok = false;
+            return {};
+        }
+        std::string result((const char*) &m_data[m_pos], length);
+        m_pos += length;
+        return result;
+    }
+
+    std::string string() {
+        std::string result;
+        uint8_t c;
+        while ((c = byte()) != 0 && m_ok)
+            result += char(c);
+        return result;
+    }
+
+    float value() {
+        auto raw = bytes(4);
+        float v = 0.f;
+        if (m_ok)
+            memcpy(&v, raw.data(), sizeof(v));
+        return v;
+    }
+
+private:
+    const std::vector<uint8_t>& m_data;
+    size_t m_pos = 0;
+    bool m_ok = true;
+};
+
+
+bool Replay::load(const char* path)
+{
+    FILE* f = fopen(path, "rb");
+    if (f == nullptr) {
+        m_error = std::string("cannot open ") + path;
+        return false;
+    }
+    std::vector<uint8_t> data;
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) != 0)
+        data.insert(data.end(), buf, buf + n);
+    fclose(f);
+
+    if (data.size() < sizeof(trace::magic) || memcmp(data.data(), trace::magic, sizeof(trace::magic)) != 0) {
+        m_error = "not a trace (bad magic)";
+        return false;
+    }
+
+    Reader in(data);
+    in.bytes(sizeof(trace::magic));
+    unsigned long time = 0;
+    unsigned long last_send = 0;    // in the current connection
+    while (!in.done() && !m_truncated) {
+        auto type = Record(in.byte());
+        time += in.varint();
+        switch (type) {
+            case Record::Name: {
+                size_t id = in.byte();
+                if (id >= m_series.size())
+                    m_series.resize(id + 1);
+                m_series[id].measurement = in.string();
+                m_series[id].sensor = in.string();
+                break;
+            }
+            case Record::Sensor: {
+                size_t id = in.byte();
+                float value = in.value();
+                if (id >= m_series.size()) {
+                    m_error = "sensor value without name";
+                    return false;
+                }
+                m_series[id].samples.emplace_back(time, value);
+                break;
+            }
+            case Record::Wifi:
+                m_wifi.emplace_back(time, in.byte() != 0);
+                break;
+            case Record::Connect: {
+                Connection conn;
+                conn.ok = in.byte() != 0;
+                conn.duration = in.varint();
+                m_connections.push_back(conn);
+                last_send = time + conn.duration;
+                break;
+            }
+            case Record::Send:
+            case Record::Receive:
+            case Record::Closed: {
+                std::string bytes;
+                if (type != Record::Closed)
+                    bytes = in.bytes(in.varint());
+                if (m_connections.empty()) {
+                    m_error = "connection data before connect";
+                    return false;
+                }
+                auto& conn = m_connections.back();
+                unsigned long delay = time > last_send ? time - last_send : 0;
+                if (type == Record::Send) {
+                    conn.sent += bytes.size();
+                    last_send = time;
+                } else if (type == Record::Receive) {
+                    conn.data += bytes;
+                    conn.chunks.push_back({conn.data.size(), delay});
+                } else {
+                    conn.closed = true;
+                    conn.close_delay = delay;
+                }
+                break;
+            }
+            case Record::Dropped:
+                // Records are missing, the rest can't be replayed
+                m_truncated = true;
+                break;
+            default:
+                m_error = "unknown record at offset " + std::to_string(in.pos() - 2);
+                return false;
+        }
+        if (!in.ok()) {
+            m_error = "truncated record";
+            return false;
+        }
+        m_end = time;
+    }
+    // No allocations while the firmware runs, they would be counted
+    m_exchanges.reserve(m_connections.size());
+    return true;
+}
+
+
+void Replay::wait()
+{
+    m_now = m_wait > m_now ? m_wait : m_now + 1;
+    m_wait = 0;
+}
+
+
+bool Replay::wifi()
+{
+    while (m_wifi_next != m_wifi.size() && m_wifi[m_wifi_next].first <= m_now)
+        ++m_wifi_next;
+    // connected until the first check is recorded
+    return m_wifi_next == 0 || m_wifi[m_wifi_next - 1].second;
+}
+
+
+bool Replay::connect()
+{
+    stop();
+    if (m_next == m_connections.size()) {
+        ++m_unmatched;
+        return false;
+    }
+    Connection& conn = m_connections[m_next++];
+    Exchange ex;
+    ex.start = m_now;
+    ex.ok = conn.ok;
+    ex.recorded_sent = conn.sent;
+    m_now += conn.duration;
+    if (!conn.ok) {
+        ex.end = m_now;
+        m_exchanges.push_back(ex);
+        return false;
+    }
+    m_exchanges.push_back(ex);
+    m_conn = &conn;
+    m_sent_at = m_now;
+    m_pos = 0;
+    m_ready = 0;
+    return true;
+}
+
+
+void Replay::write(size_t length)
+{
+    if (m_conn == nullptr)
+        return;
+    m_exchanges.back().sent += length;
+    m_sent_at = m_now;
+}
+
+
+int Replay::available()
+{
+    if (m_conn == nullptr)
+        return 0;
+    auto& chunks = m_conn->chunks;
+    while (m_ready != chunks.size() && m_sent_at + chunks[m_ready].delay <= m_now)
+        ++m_ready;
+    size_t end = m_ready == 0 ? 0 : chunks[m_ready - 1].end;
+    if (end == m_pos && m_ready != chunks.size())
+        m_wait = m_sent_at + chunks[m_ready].delay;
+    return int(end - m_pos);
+}
+
+
+int Replay::read()
+{
+    if (available() == 0)
+        return -1;
+    return (uint8_t) m_conn->data[m_pos++];
+}
+
+
+int Replay::peek()
+{
+    if (available() == 0)
+        return -1;
+    return (uint8_t) m_conn->data[m_pos];
+}
+
+
+bool Replay::connected()
+{
+    if (m_conn == nullptr)
+        return false;
+    if (available() != 0 || m_ready != m_conn->chunks.size())
+        return true;
+    // All data received. Without recorded close, the firmware closed
+    // the connection itself - don't let a different firmware wait forever.
+    if (!m_conn->closed)
+        return false;
+    unsigned long closed_at = m_sent_at + m_conn->close_delay;
+    if (m_now < closed_at) {
+        m_wait = closed_at;
+        return true;
+    }
+    return false;
+}
+
+
+void Replay::stop()
+{
+    if (m_conn == nullptr)
+        return;
+    m_exchanges.back().end = m_now;
+    m_conn = nullptr;
+}
+
+} // namespace sim
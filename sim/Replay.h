@@ -0,0 +1,121 @@
+// Replay.h - created by Radek Brich on 2026-10-19
+// Replay of a device session recorded with -DWITH_TRACE (src/Trace.h)
+
+#ifndef GADGETS_SIM_REPLAY_H
+#define GADGETS_SIM_REPLAY_H
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace sim {
+
+// Feeds a recorded trace to the firmware: sensor values, Wi-Fi state
+// and server responses, on a virtual clock. The clock advances only
+// in delay(), yield() and recorded connect time, so a replay is
+// deterministic: the same trace and firmware give the same results.
+//
+// Responses are timed relative to the end of the request, as recorded
+// (server and network latency). A firmware which sends something else
+// still gets the recorded response, the bytes sent are only counted.
+class Replay {
+public:
+    // Returns false on error, see `error()`
+    bool load(const char* path);
+    const std::string& error() const { return m_error; }
+
+    // Time of the last record, the replay ends there
+    unsigned long end() const { return m_end; }
+    // The recorder dropped records (full buffer), the trace ends early
+    bool truncated() const { return m_truncated; }
+
+    // Virtual clock, ms
+    unsigned long now() const { return m_now; }
+    void advance(unsigned long ms) { m_now += ms; }
+    // yield(): skip to the awaited data (or 1 ms)
+    void wait();
+
+    // Recorded inputs at current time (the clock never goes back)
+    bool wifi();
+    template <typename F>
+    void values(const F& fn) {
+        for (auto& s : m_series) {
+            while (s.next != s.samples.size() && s.samples[s.next].first <= m_now)
+                ++s.next;
+            if (s.next != 0)
+                fn(s.measurement.c_str(), s.sensor.c_str(), s.samples[s.next - 1].second);
+        }
+    }
+
+    // WiFiClient, one connection at a time, the recorded connections in order
+    bool connect();
+    void write(size_t length);
+    int available();
+    int read();
+    int peek();
+    bool connected();
+    void stop();
+
+    // One connect .. stop
+    struct Exchange {
+        unsigned long start = 0;    // virtual ms
+        unsigned long end = 0;
+        bool ok = false;            // connected
+        size_t sent = 0;            // bytes written by the firmware
+        size_t recorded_sent = 0;   // ... and in the recorded session
+    };
+    const std::vector<Exchange>& exchanges() const { return m_exchanges; }
+    // connect() calls over the recorded ones
+    unsigned unmatched() const { return m_unmatched; }
+    size_t recorded_connections() const { return m_connections.size(); }
+    size_t replayed_connections() const { return m_next; }
+
+private:
+    struct Series {
+        std::string measurement;
+        std::string sensor;
+        std::vector<std::pair<unsigned long, float>> samples;
+        size_t next = 0;                // first sample in future
+    };
+
+    // Data up to `end` is available `delay` ms after the last write
+    struct Chunk {
+        size_t end;
+        unsigned long delay;
+    };
+
+    struct Connection {
+        bool ok = false;
+        unsigned long duration = 0;     // of connect()
+        size_t sent = 0;
+        std::string data;               // received
+        std::vector<Chunk> chunks;
+        bool closed = false;            // by the server, `close_delay` after the last write
+        unsigned long close_delay = 0;
+    };
+
+    std::string m_error;
+    unsigned long m_end = 0;
+    bool m_truncated = false;
+    std::vector<Series> m_series;
+    std::vector<std::pair<unsigned long, bool>> m_wifi;
+    size_t m_wifi_next = 0;
+    std::vector<Connection> m_connections;
+
+    unsigned long m_now = 0;
+    unsigned long m_wait = 0;           // awaited event, 0 = none
+
+    // current connection
+    Connection* m_conn = nullptr;
+    size_t m_next = 0;                  // next recorded connection
+    unsigned long m_sent_at = 0;        // time of the last write
+    size_t m_pos = 0;                   // read position in `data`
+    size_t m_ready = 0;                 // chunks available so far
+    std::vector<Exchange> m_exchanges;
+    unsigned m_unmatched = 0;
+};
+
+} // namespace sim
+
+#endif // include guard
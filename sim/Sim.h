@@ -0,0 +1,130 @@
+// Sim.h - created by Radek Brich on 2026-10-19
+// Fleet simulator: options, virtual device context, statistics
+
+#ifndef GADGETS_SIM_SIM_H
+#define GADGETS_SIM_SIM_H
+
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace sim {
+
+struct Options {
+    int devices = 10;
+    double interval = 10.0;     // s (real), one device reports once per interval
+    double jitter = 0.1;        // relative spread of device clock speed
+    double duration = 60.0;     // s (real)
+    std::string server_host = "127.0.0.1";  // all connections go here
+    uint16_t server_port = 8086;
+    double fail_wifi = 0.0;     // probability of Wi-Fi being down in a check
+    double fail_connect = 0.0;  // probability of failed TCP connect
+    double drop = 0.0;          // probability of connection lost before response
+    unsigned long min_delay = 100;  // ms (virtual), shortest delay() to save CPU
+    bool verbose = false;       // print Serial output of devices
+    std::string record;         // trace file for device 0 (-DWITH_TRACE)
+    std::string replay;         // trace file to replay, instead of the fleet
+    std::vector<std::string> standins;  // "HOST=MODE", see StandIn
+};
+
+extern Options options;
+
+// Local stand-in of the C&C server for one host name in DB_ENDPOINTS,
+// connections to other hosts go to `server_host`. Modes:
+//   ok         responds at once: 200, or 304 to a conditional GET
+//   slow:MS    responds after MS (real) milliseconds
+//   down       refuses connections
+//   blackhole  connect times out (costs the device its connect timeout)
+//   hang       accepts the connection, never responds
+//   flap:S     alternates S (real) seconds up and S seconds down
+class StandIn {
+public:
+    enum class Mode { Ok, Slow, Down, Blackhole, Hang, Flap };
+
+    // Start the stand-ins from `options.standins`, false on error
+    static bool start_all();
+
+    const std::string& host() const { return m_host; }
+    Mode mode() const { return m_mode; }
+    bool up() const;
+    // Port on 127.0.0.1 - a closed one while down
+    uint16_t port() const;
+
+    // nullptr when `host` has no stand-in
+    static const StandIn* find(const char* host);
+    static bool any();
+
+private:
+    bool start(const std::string& spec);
+    void serve(int fd) const;
+
+    std::string m_host;
+    Mode m_mode = Mode::Ok;
+    unsigned m_ms = 0;          // Slow: response delay, Flap: half period
+    uint16_t m_port = 0;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+using Clock = std::chrono::steady_clock;
+
+class Replay;
+
+// Virtual device, one per thread
+struct Device {
+    int id = 0;
+    std::mt19937 rng;
+    Clock::time_point start;
+    double speed = 1.0;         // virtual ms per real ms
+    unsigned long offset = 0;   // virtual ms at start
+    std::string serial_line;
+    int wait_fd = -1;           // socket to wait for in yield()
+    Replay* replay = nullptr;   // inputs and clock from a trace
+};
+
+extern thread_local Device* device;
+
+// Heap allocations made by this thread (sim/Heap.cpp)
+extern thread_local unsigned long allocations;
+
+// Random event with probability `p`, in current device
+bool chance(double p);
+
+enum class Error {
+    None,
+    Connect,        // TCP connect failed (refused, timeout)
+    InjectedConnect,
+    InjectedDrop,
+    NoResponse,     // closed without status line
+};
+
+class Stats {
+public:
+    // One request/response exchange (connect .. stop)
+    void record(const std::string& request, int status, double latency_ms, Error error);
+    void record_wifi_down();
+
+    // Print summary, `elapsed` is real time in seconds
+    void report(FILE* f, double elapsed, bool detail);
+
+private:
+    struct Endpoint {
+        std::vector<double> latency_ms;
+        std::map<int, unsigned> statuses;
+        unsigned errors[5] = {};
+    };
+
+    std::mutex m_mutex;
+    std::map<std::string, Endpoint> m_endpoints;
+    unsigned m_wifi_down = 0;
+    unsigned m_reported = 0;    // requests in previous report
+};
+
+extern Stats stats;
+
+} // namespace sim
+
+#endif // include guard
@@ -0,0 +1,109 @@
+// SimSensor.cpp - created by Radek Brich on 2026-10-19
+
+#include "config.h"
+#include "Sensor.h"
+#include "Replay.h"
+#include "Sim.h"
+#include <Arduino.h>
+
+// Simulated temperature + humidity sensor (random walk),
+// each virtual device has its own values.
+// In replay, it stands for the recorded sensors and outputs their values.
+class SimSensor final: public Sensor {
+public:
+    SimSensor() noexcept;
+    void setup() override;
+    void output_to_stream(Print& stream) override;
+    void output_to_database(Print& query) override;
+    void output_values(const ValueCallback& fn) override;
+
+private:
+    void sample() override;
+
+    struct Values {
+        float temperature = 0.f;
+        float humidity = 0.f;
+    };
+    static thread_local Values m_values;
+};
+
+
+static SimSensor s_sim_sensor;
+thread_local SimSensor::Values SimSensor::m_values;
+
+
+// No cache - the instance is shared by all devices (threads),
+// the cache state in Sensor is not per device
+SimSensor::SimSensor() noexcept : Sensor(0)
+{
+    Sensor::add(&s_sim_sensor);
+}
+
+
+void SimSensor::setup()
+{
+    m_values.temperature = 18.f + random(600) / 100.f;
+    m_values.humidity = 40.f + random(2000) / 100.f;
+}
+
+
+void SimSensor::sample()
+{
+    m_values.temperature += (random(21) - 10) / 100.f;
+    m_values.humidity += (random(21) - 10) / 50.f;
+}
+
+
+void SimSensor::output_to_stream(Print& stream)
+{
+    if (sim::device->replay != nullptr) {
+        sim::device->replay->values([&stream](const char* measurement, const char* sensor, float value) {
+            stream.printf("[%s] %s: %.2f\n", sensor, measurement, value);
+        });
+        return;
+    }
+    stream.print("[sim] Temperature: ");
+    stream.print(m_values.temperature);
+    stream.println("°C");
+    stream.print("[sim] Humidity: ");
+    stream.print(m_values.humidity);
+    stream.println("%");
+}
+
+
+void SimSensor::output_to_database(Print& query)
+{
+    if (sim::device->replay != nullptr) {
+        sim::device->replay->values([&query](const char* measurement, const char* sensor, float value) {
+            query.print(measurement);
+            query.print(",sensor=");
+            query.print(sensor);
+            query.print("," DEVICE_TAGS " value=");
+            query.print(value);
+            query.print('\n');
+        });
+        return;
+    }
+    query.print("temperature,sensor=Sim," DEVICE_TAGS ",sim=");
+    query.print(sim::device->id);
+    query.print(" value=");
+    query.print(m_values.temperature);
+    query.print('\n');
+
+    query.print("humidity,sensor=Sim," DEVICE_TAGS ",sim=");
+    query.print(sim::device->id);
+    query.print(" value=");
+    query.print(m_values.humidity);
+    query.print('\n');
+}
+
+
+void SimSensor::output_values(const ValueCallback& fn)
+{
+    if (sim::device->replay != nullptr) {
+        sim::device->replay->values(fn);
+        return;
+    }
+    fn("temperature", "Sim", m_values.temperature);
+    fn("humidity", "Sim", m_values.humidity);
+}
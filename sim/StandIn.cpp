@@ -0,0 +1,188 @@
+// StandIn.cpp - created by Radek Brich on 2026-10-19
+// Local stand-ins of the C&C server, for failover tests of DB_ENDPOINTS
+
+#include "Sim.h"
+#include <arpa/inet.h>
+#include <cstring>
+#include <memory>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+namespace sim {
+
+static std::vector<std::unique_ptr<StandIn>> s_standins;
+static uint16_t s_closed_port = 0;   // nothing listens there
+
+
+// Listening socket on 127.0.0.1, any free port
+static int listen_local(uint16_t& port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1)
+        return -1;
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (bind(fd, (sockaddr*) &addr, sizeof(addr)) != 0
+    || getsockname(fd, (sockaddr*) &addr, &len) != 0
+    || listen(fd, 128) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    port = ntohs(addr.sin_port);
+    return fd;
+}
+
+
+bool StandIn::start_all()
+{
+    if (options.standins.empty())
+        return true;
+    // A port which refuses connections: bound, then closed without listening
+    int fd = listen_local(s_closed_port);
+    if (fd == -1)
+        return false;
+    ::close(fd);
+    for (const auto& spec : options.standins) {
+        auto standin = std::make_unique<StandIn>();
+        if (!standin->start(spec)) {
+            fprintf(stderr, "--standin %s: invalid, or cannot listen\n", spec.c_str());
+            return false;
+        }
+        s_standins.push_back(std::move(standin));
+    }
+    return true;
+}
+
+
+const StandIn* StandIn::find(const char* host)
+{
+    for (const auto& standin : s_standins)
+        if (standin->m_host == host)
+            return standin.get();
+    return nullptr;
+}
+
+
+bool StandIn::any()
+{
+    return !s_standins.empty();
+}
+
+
+bool StandIn::start(const std::string& spec)
+{
+    auto eq = spec.find('=');
+    if (eq == std::string::npos || eq == 0)
+        return false;
+    m_host = spec.substr(0, eq);
+    std::string mode = spec.substr(eq + 1);
+    auto colon = mode.find(':');
+    if (colon != std::string::npos) {
+        m_ms = unsigned(atoi(mode.c_str() + colon + 1));
+        mode.resize(colon);
+    }
+    if (mode == "ok")
+        m_mode = Mode::Ok;
+    else if (mode == "slow" && colon != std::string::npos)
+        m_mode = Mode::Slow;
+    else if (mode == "down")
+        m_mode = Mode::Down;
+    else if (mode == "blackhole")
+        m_mode = Mode::Blackhole;
+    else if (mode == "hang")
+        m_mode = Mode::Hang;
+    else if (mode == "flap" && m_ms != 0) {
+        m_mode = Mode::Flap;
+        m_ms *= 1000;
+    } else
+        return false;
+    m_start = std::chrono::steady_clock::now();
+    if (m_mode == Mode::Down || m_mode == Mode::Blackhole)
+        return true;
+
+    int fd = listen_local(m_port);
+    if (fd == -1)
+        return false;
+    std::thread([this, fd] {
+        for (;;) {
+            int conn = accept(fd, nullptr, nullptr);
+            if (conn != -1)
+                std::thread(&StandIn::serve, this, conn).detach();
+        }
+    }).detach();
+    return true;
+}
+
+
+bool StandIn::up() const
+{
+    switch (m_mode) {
+        case Mode::Down:
+        case Mode::Blackhole:
+            return false;
+        case Mode::Flap: {
+            std::chrono::duration<double, std::milli> t = std::chrono::steady_clock::now() - m_start;
+            return (unsigned long) (t.count() / m_ms) % 2 == 0;
+        }
+        default:
+            return true;
+    }
+}
+
+
+uint16_t StandIn::port() const
+{
+    return up() ? m_port : s_closed_port;
+}
+
+
+// One exchange: read the request (headers + Content-Length body),
+// respond without commands and close
+void StandIn::serve(int fd) const
+{
+    std::string request;
+    char buf[1024];
+    size_t body_end = std::string::npos;
+    while (body_end == std::string::npos || request.size() < body_end) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0)
+            break;
+        request.append(buf, size_t(n));
+        auto headers_end = request.find("\r\n\r\n");
+        if (body_end == std::string::npos && headers_end != std::string::npos) {
+            auto cl = request.find("Content-Length: ");
+            size_t length = cl < headers_end ? size_t(atol(request.c_str() + cl + 16)) : 0;
+            body_end = headers_end + 4 + length;
+        }
+    }
+    if (m_mode == Mode::Slow)
+        std::this_thread::sleep_for(std::chrono::milliseconds(m_ms));
+    if (m_mode == Mode::Hang) {
+        // Hold the connection until the device gives up
+        while (recv(fd, buf, sizeof(buf), 0) > 0)
+            ;
+        ::close(fd);
+        return;
+    }
+
+    // "GET /control/dev HTTP/1.1" -> "dev"
+    std::string device;
+    auto path = request.find(' ') + 1;
+    auto slash = request.find('/', path + 1);
+    if (path != 0 && slash != std::string::npos) {
+        auto end = request.find_first_of("? ", slash + 1);
+        device = request.substr(slash + 1, end - slash - 1);
+    }
+    bool conditional = request.find("If-None-Match: ") != std::string::npos;
+    int len = snprintf(buf, sizeof(buf),
+            "HTTP/1.1 %s\r\nX-Device: %s\r\nContent-Length: 0\r\nConnection: close\r\n\r\n",
+            conditional ? "304 Not Modified" : "200 OK", device.c_str());
+    send(fd, buf, size_t(len), MSG_NOSIGNAL);
+    ::close(fd);
+}
+
+} // namespace sim
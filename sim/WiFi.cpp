@@ -0,0 +1,397 @@
+// WiFi.cpp - created by Radek Brich on 2026-10-19
+// ESP8266 Wi-Fi API for the host build, with failure injection
+// (or fed from a recorded trace, see Replay.h)
+
+#include "ESP8266WiFi.h"
+#include "Replay.h"
+#include "Sim.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace sim;
+
+ESP8266WiFiClass WiFi;
+
+// All connections go to the simulated server, regardless of requested host
+// (except the hosts with a stand-in)
+static bool resolve_server(IPAddress& result)
+{
+    static std::mutex mutex;
+    static IPAddress cached;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!cached.isSet()) {
+        addrinfo hints {};
+        hints.ai_family = AF_INET;
+        addrinfo* res = nullptr;
+        if (getaddrinfo(options.server_host.c_str(), nullptr, &hints, &res) != 0 || !res)
+            return false;
+        cached = IPAddress(((sockaddr_in*) res->ai_addr)->sin_addr.s_addr);
+        freeaddrinfo(res);
+    }
+    result = cached;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// IPAddress
+
+bool IPAddress::fromString(const char* address)
+{
+    in_addr addr {};
+    if (inet_pton(AF_INET, address, &addr) != 1)
+        return false;
+    m_addr = addr.s_addr;
+    return true;
+}
+
+String IPAddress::toString() const
+{
+    char buf[INET_ADDRSTRLEN];
+    in_addr addr {m_addr};
+    inet_ntop(AF_INET, &addr, buf, sizeof(buf));
+    return String(buf);
+}
+
+size_t IPAddress::printTo(Print& p) const
+{
+    char buf[INET_ADDRSTRLEN];
+    in_addr addr {m_addr};
+    inet_ntop(AF_INET, &addr, buf, sizeof(buf));
+    return p.print(buf);
+}
+
+// -----------------------------------------------------------------------------
+// WiFi
+
+bool ESP8266WiFiClass::isConnected()
+{
+    if (device->replay != nullptr)
+        return device->replay->wifi();
+    if (chance(options.fail_wifi)) {
+        stats.record_wifi_down();
+        return false;
+    }
+    return true;
+}
+
+int ESP8266WiFiClass::hostByName(const char* host, IPAddress& result)
+{
+    return resolve_server(result) ? 1 : 0;
+}
+
+// -----------------------------------------------------------------------------
+// WiFiClient
+
+int WiFiClient::connect(const char* host, uint16_t port)
+{
+    if (device->replay != nullptr)
+        return device->replay->connect() ? 1 : 0;
+    if (const StandIn* standin = StandIn::find(host)) {
+        if (standin->mode() == StandIn::Mode::Blackhole) {
+            // No answer to SYN, the connect waits for its timeout
+            stop();
+            m_host = host;
+            auto start = Clock::now();
+            delay(m_timeout);
+            std::chrono::duration<double, std::milli> latency = Clock::now() - start;
+            stats.record(key("CONNECT"), -1, latency.count(), Error::Connect);
+            return 0;
+        }
+        IPAddress ip;
+        ip.fromString("127.0.0.1");
+        return open(ip, standin->port(), host);
+    }
+    IPAddress ip;
+    if (!resolve_server(ip)) {
+        stats.record(std::string("CONNECT ") + host, -1, 0.0, Error::Connect);
+        return 0;
+    }
+    return open(ip, options.server_port, host);
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port)
+{
+    if (device->replay != nullptr)
+        return device->replay->connect() ? 1 : 0;
+    return open(ip, options.server_port, nullptr);
+}
+
+int WiFiClient::open(IPAddress ip, uint16_t port, const char* host)
+{
+    stop();
+    m_host = host;
+    m_start = Clock::now();
+    m_eof = false;
+    m_dropped = false;
+    m_rx_pos = m_rx_len = 0;
+    m_request_len = m_status_len = 0;
+    m_request[0] = m_status_line[0] = '\0';
+
+    if (chance(options.fail_connect)) {
+        stats.record(key("CONNECT"), -1, 0.0, Error::InjectedConnect);
+        return 0;
+    }
+    m_drop_pending = chance(options.drop);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1)
+        return 0;
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = ip;
+
+    // Connect with timeout (like ClientContext on ESP8266)
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    int rc = ::connect(fd, (sockaddr*) &addr, sizeof(addr));
+    if (rc == -1 && errno == EINPROGRESS) {
+        pollfd pfd {fd, POLLOUT, 0};
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (poll(&pfd, 1, int(m_timeout)) == 1
+        && getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) == 0 && err == 0)
+            rc = 0;
+    }
+    if (rc != 0) {
+        ::close(fd);
+        std::chrono::duration<double, std::milli> latency = Clock::now() - m_start;
+        stats.record(key("CONNECT"), -1, latency.count(), Error::Connect);
+        return 0;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+
+    m_fd = fd;
+    m_remote_ip = ip;
+    return 1;
+}
+
+uint8_t WiFiClient::connected()
+{
+    if (device->replay != nullptr)
+        return device->replay->connected();
+    if (m_fd == -1)
+        return m_rx_pos < m_rx_len;
+    if (m_rx_pos == m_rx_len && !m_eof)
+        fill(false);
+    return !m_eof || m_rx_pos < m_rx_len;
+}
+
+void WiFiClient::stop()
+{
+    if (device != nullptr && device->replay != nullptr) {
+        device->replay->stop();
+        return;
+    }
+    if (m_fd != -1) {
+        ::close(m_fd);
+        m_fd = -1;
+        record();
+    }
+    m_rx_pos = m_rx_len = 0;
+}
+
+void WiFiClient::record()
+{
+    std::chrono::duration<double, std::milli> latency = Clock::now() - m_start;
+    // "GET /control/dev?seq=1 HTTP/1.1" -> "GET /control/dev"
+    std::string request(m_request, m_request_len);
+    auto end = request.find_first_of("? ", request.find(' ') + 1);
+    request = request.substr(0, end);
+
+    int status = -1;
+    if (m_status_len > 9 && strncmp(m_status_line, "HTTP/", 5) == 0)
+        status = atoi(m_status_line + 9);
+
+    Error error = Error::None;
+    if (m_dropped)
+        error = Error::InjectedDrop;
+    else if (status == -1)
+        error = Error::NoResponse;
+    stats.record(key(request), status, latency.count(), error);
+}
+
+std::string WiFiClient::key(const std::string& request) const
+{
+    if (!StandIn::any() || m_host == nullptr)
+        return request;
+    return request + " @" + m_host;
+}
+
+bool WiFiClient::fill(bool wait)
+{
+    if (m_fd == -1 || m_eof)
+        return false;
+    if (m_drop_pending && m_request_len != 0) {
+        // Injected failure: the request was sent, but the response is lost
+        ::close(m_fd);
+        m_fd = -1;
+        m_eof = true;
+        m_dropped = true;
+        record();
+        return false;
+    }
+    ssize_t n = recv(m_fd, m_rx_buf, sizeof(m_rx_buf), wait ? 0 : MSG_DONTWAIT);
+    if (n > 0) {
+        m_rx_pos = 0;
+        m_rx_len = size_t(n);
+        // Keep the status line for statistics
+        for (size_t i = 0; i < m_rx_len && m_status_len < sizeof(m_status_line) - 1; ++i) {
+            if (m_rx_buf[i] == '\n') {
+                m_status_len = sizeof(m_status_line) - 1;
+                break;
+            }
+            m_status_line[m_status_len++] = (char) m_rx_buf[i];
+        }
+        return true;
+    }
+    if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+        m_eof = true;
+    return false;
+}
+
+size_t WiFiClient::write(const uint8_t* buffer, size_t size)
+{
+    if (device->replay != nullptr) {
+        device->replay->write(size);
+        return size;
+    }
+    if (m_fd == -1)
+        return 0;
+    for (size_t i = 0; i < size && m_request_len < sizeof(m_request) - 1; ++i) {
+        if (buffer[i] == '\r' || buffer[i] == '\n') {
+            m_request_len = sizeof(m_request) - 1;
+            break;
+        }
+        m_request[m_request_len++] = (char) buffer[i];
+    }
+    size_t sent = 0;
+    while (sent < size) {
+        ssize_t n = send(m_fd, buffer + sent, size - sent, MSG_NOSIGNAL);
+        if (n <= 0)
+            break;
+        sent += size_t(n);
+    }
+    return sent;
+}
+
+int WiFiClient::availableForWrite()
+{
+    return m_fd == -1 ? 0 : (int) sizeof(m_rx_buf);
+}
+
+int WiFiClient::available()
+{
+    if (device->replay != nullptr)
+        return device->replay->available();
+    if (m_rx_pos == m_rx_len && !fill(false) && m_fd != -1)
+        device->wait_fd = m_fd;
+    return int(m_rx_len - m_rx_pos);
+}
+
+int WiFiClient::read()
+{
+    if (device->replay != nullptr)
+        return device->replay->read();
+    if (available() == 0)
+        return -1;
+    return m_rx_buf[m_rx_pos++];
+}
+
+int WiFiClient::read(uint8_t* buffer, size_t size)
+{
+    if (device->replay != nullptr) {
+        size_t n = 0;
+        while (n != size && device->replay->available() != 0)
+            buffer[n++] = (uint8_t) device->replay->read();
+        return (int) n;
+    }
+    size_t n = std::min(size, size_t(available()));
+    memcpy(buffer, m_rx_buf + m_rx_pos, n);
+    m_rx_pos += n;
+    return (int) n;
+}
+
+int WiFiClient::peek()
+{
+    if (device->replay != nullptr)
+        return device->replay->peek();
+    if (available() == 0)
+        return -1;
+    return m_rx_buf[m_rx_pos];
+}
+
+void WiFiClient::setNoDelay(bool nodelay)
+{
+    int flag = nodelay ? 1 : 0;
+    if (m_fd != -1)
+        setsockopt(m_fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+}
+
+// -----------------------------------------------------------------------------
+// WiFiUDP
+
+uint8_t WiFiUDP::begin(uint16_t port)
+{
+    stop();
+    m_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (m_fd == -1)
+        return 0;
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (bind(m_fd, (sockaddr*) &addr, sizeof(addr)) != 0) {
+        stop();
+        return 0;
+    }
+    return 1;
+}
+
+void WiFiUDP::stop()
+{
+    if (m_fd != -1) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port)
+{
+    if (m_fd == -1 && (m_fd = socket(AF_INET, SOCK_DGRAM, 0)) == -1)
+        return 0;
+    m_dest_ip = ip;
+    m_dest_port = port;
+    m_tx_len = 0;
+    return 1;
+}
+
+int WiFiUDP::beginPacket(const char* host, uint16_t port)
+{
+    IPAddress ip;
+    return resolve_server(ip) ? beginPacket(ip, port) : 0;
+}
+
+size_t WiFiUDP::write(const uint8_t* buffer, size_t size)
+{
+    size = std::min(size, sizeof(m_tx_buf) - m_tx_len);
+    memcpy(m_tx_buf + m_tx_len, buffer, size);
+    m_tx_len += size;
+    return size;
+}
+
+int WiFiUDP::endPacket()
+{
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(m_dest_port);
+    addr.sin_addr.s_addr = m_dest_ip;
+    ssize_t n = sendto(m_fd, m_tx_buf, m_tx_len, 0, (sockaddr*) &addr, sizeof(addr));
+    m_tx_len = 0;
+    return n >= 0 ? 1 : 0;
+}
@@ -0,0 +1,389 @@
+// fleet_sim.cpp - created by Radek Brich on 2026-10-19
+
+// Fleet simulator: runs N virtual sensor devices (the real sensors.cpp
+// and HttpClient code, one thread each) against gadget_central.py
+// and reports throughput, latency percentiles and error rates.
+//
+// Build and run:
+//   pio run -e fleet_sim
+//   .pio/build/fleet_sim/program --devices 200 --interval 10 --server 127.0.0.1:8086
+//
+// Replay of a recorded session (src/Trace.h), compares firmware versions
+// on the same input - cycle latency, host CPU time, heap allocations:
+//   .pio/build/fleet_sim/program --replay session.trace
+//
+// Failover between DB_ENDPOINTS (src/Endpoints.h), against local stand-ins
+// of the server instead of --server, e.g.:
+//   .pio/build/fleet_sim/program --standin server.lan=flap:30 --standin backup.lan=slow:50
+
+#include "config.h"
+#include "Replay.h"
+#include "Sim.h"
+#include "Trace.h"
+#include <Arduino.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+// sensors.cpp
+void setup();
+void loop();
+
+namespace sim {
+
+Options options;
+Stats stats;
+thread_local Device* device = nullptr;
+
+static const char* error_names[] = {"ok", "connect", "inj-connect", "inj-drop", "no-response"};
+
+
+bool chance(double p)
+{
+    return p > 0.0 && std::uniform_real_distribution<double>(0.0, 1.0)(device->rng) < p;
+}
+
+
+void Stats::record(const std::string& request, int status, double latency_ms, Error error)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto& ep = m_endpoints[request];
+    ep.errors[int(error)]++;
+    if (error == Error::None) {
+        ep.latency_ms.push_back(latency_ms);
+        ep.statuses[status]++;
+    }
+}
+
+
+void Stats::record_wifi_down()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_wifi_down;
+}
+
+
+static double percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty())
+        return 0.0;
+    return sorted[size_t(p * double(sorted.size() - 1) + 0.5)];
+}
+
+
+void Stats::report(FILE* f, double elapsed, bool detail)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    unsigned total = 0;
+    unsigned failed = 0;
+    for (auto& [name, ep] : m_endpoints) {
+        for (int i = 0; i < 5; ++i)
+            total += ep.errors[i];
+        for (int i = 1; i < 5; ++i)
+            failed += ep.errors[i];
+        for (auto& [status, count] : ep.statuses)
+            if (status >= 500)
+                failed += count;
+    }
+
+    if (!detail) {
+        fprintf(f, "t=%5.0fs  requests %u (+%u)  %.1f req/s  failed %u  wifi-down %u\n",
+                elapsed, total, total - m_reported, total / elapsed, failed, m_wifi_down);
+        m_reported = total;
+        return;
+    }
+
+    fprintf(f, "\n%-32s %7s %8s %8s %8s %8s %8s  %s\n",
+            "request", "count", "req/s", "p50 ms", "p90 ms", "p99 ms", "max ms", "status / errors");
+    for (auto& [name, ep] : m_endpoints) {
+        auto sorted = ep.latency_ms;
+        std::sort(sorted.begin(), sorted.end());
+        unsigned count = 0;
+        for (unsigned n : ep.errors)
+            count += n;
+        fprintf(f, "%-32s %7u %8.2f %8.1f %8.1f %8.1f %8.1f ",
+                name.c_str(), count, count / elapsed,
+                percentile(sorted, 0.5), percentile(sorted, 0.9), percentile(sorted, 0.99),
+                sorted.empty() ? 0.0 : sorted.back());
+        for (auto& [status, n] : ep.statuses)
+            fprintf(f, " %d:%u", status, n);
+        for (int i = 1; i < 5; ++i)
+            if (ep.errors[i] != 0)
+                fprintf(f, " %s:%u", error_names[i], ep.errors[i]);
+        fputc('\n', f);
+    }
+    fprintf(f, "\nTotal: %u requests in %.1f s (%.1f req/s), failed %u (%.2f %%), wifi-down checks %u\n",
+            total, elapsed, total / elapsed, failed,
+            total ? 100.0 * failed / total : 0.0, m_wifi_down);
+}
+
+} // namespace sim
+
+using namespace sim;
+
+static std::atomic<bool> running {true};
+
+
+// Trace collector of the recorded device
+class FileSink: public Print {
+public:
+    explicit FileSink(FILE* file) : m_file(file) {
+        // stdio would allocate its buffer on first write, in loop()
+        setvbuf(m_file, m_buffer, _IOFBF, sizeof(m_buffer));
+    }
+    size_t write(uint8_t c) override { return fputc(c, m_file) == EOF ? 0 : 1; }
+    size_t write(const uint8_t* buffer, size_t size) override { return fwrite(buffer, 1, size, m_file); }
+    int availableForWrite() override { return sizeof(m_buffer); }
+    void flush() override { fflush(m_file); }
+
+private:
+    FILE* m_file;
+    char m_buffer[4096];
+};
+
+
+static void run_device(Device* dev, double start_delay)
+{
+    device = dev;
+    dev->serial_line.reserve(256);  // no allocations in loop(), see HeapCheck.h
+
+    FILE* trace_file = nullptr;
+    std::unique_ptr<FileSink> sink;
+    if (dev->id == 0 && !options.record.empty()) {
+        trace_file = fopen(options.record.c_str(), "wb");
+        if (trace_file == nullptr)
+            perror(options.record.c_str());
+        else {
+            sink = std::make_unique<FileSink>(trace_file);
+            trace::set_sink(sink.get());
+        }
+    }
+
+    // Spread the devices over the report interval
+    std::this_thread::sleep_for(std::chrono::duration<double>(start_delay));
+    dev->start = Clock::now();
+    setup();
+    while (running)
+        loop();
+
+    if (trace_file != nullptr) {
+        trace::flush();
+        fclose(trace_file);
+    }
+}
+
+
+// Run one device on the trace clock until the end of the trace,
+// report each cycle (loop() pass with a connection)
+static int run_replay()
+{
+    Replay replay;
+    if (!replay.load(options.replay.c_str())) {
+        fprintf(stderr, "%s: %s\n", options.replay.c_str(), replay.error().c_str());
+        return 1;
+    }
+    Device dev;
+    dev.rng.seed(1);
+    dev.replay = &replay;
+    dev.serial_line.reserve(256);
+    device = &dev;
+
+    struct Cycle {
+        size_t exchange;
+        double host_us;
+        unsigned long allocs;
+    };
+    std::vector<Cycle> cycles;
+    // one per recorded connection at most, the harness must not allocate
+    // after setup() (heap_check is armed with -DCHECK_HEAP)
+    cycles.reserve(replay.recorded_connections());
+
+    unsigned long allocs = allocations;
+    setup();
+    const unsigned long setup_allocs = allocations - allocs;
+
+    unsigned long idle_passes = 0;
+    unsigned long idle_allocs = 0;
+    double idle_us = 0.0;
+    while (replay.now() < replay.end()) {
+        size_t exchanges = replay.exchanges().size();
+        allocs = allocations;
+        auto start = Clock::now();
+        loop();
+        std::chrono::duration<double, std::micro> host = Clock::now() - start;
+        allocs = allocations - allocs;
+        if (replay.exchanges().size() != exchanges)
+            cycles.push_back({replay.exchanges().size() - 1, host.count(), allocs});
+        else {
+            ++idle_passes;
+            idle_allocs += allocs;
+            idle_us += host.count();
+        }
+    }
+
+    printf("Replay of %s: %.1f s of device time, %zu cycles\n\n",
+           options.replay.c_str(), replay.end() / 1000.0, cycles.size());
+    printf("%6s %9s %11s %9s %7s %7s %11s\n",
+           "cycle", "time s", "latency ms", "host us", "allocs", "sent B", "recorded B");
+    std::vector<double> latency_ms, host_us;
+    unsigned long cycle_allocs = 0;
+    for (size_t i = 0; i != cycles.size(); ++i) {
+        auto& c = cycles[i];
+        auto& ex = replay.exchanges()[c.exchange];
+        latency_ms.push_back(double(ex.end - ex.start));
+        host_us.push_back(c.host_us);
+        cycle_allocs += c.allocs;
+        printf("%6zu %9.1f %11lu %9.0f %7lu %7zu %11zu%s\n",
+               i + 1, ex.start / 1000.0, ex.end - ex.start, c.host_us, c.allocs,
+               ex.sent, ex.recorded_sent, ex.ok ? "" : "  connect failed");
+    }
+    std::sort(latency_ms.begin(), latency_ms.end());
+    std::sort(host_us.begin(), host_us.end());
+
+    printf("\nCycle latency (device time): p50 %.0f ms, p90 %.0f ms, max %.0f ms\n",
+           percentile(latency_ms, 0.5), percentile(latency_ms, 0.9),
+           latency_ms.empty() ? 0.0 : latency_ms.back());
+    printf("Host time per cycle: p50 %.0f us, p90 %.0f us, max %.0f us; idle passes %lu, mean %.2f us\n",
+           percentile(host_us, 0.5), percentile(host_us, 0.9),
+           host_us.empty() ? 0.0 : host_us.back(),
+           idle_passes, idle_passes ? idle_us / idle_passes : 0.0);
+    printf("Heap allocations: setup %lu, loop %lu (cycles %lu, idle passes %lu)\n",
+           setup_allocs, cycle_allocs + idle_allocs, cycle_allocs, idle_allocs);
+
+    if (replay.truncated())
+        printf("Warning: the recorder dropped data, the trace ends early\n");
+    if (replay.unmatched() != 0)
+        printf("Warning: %u connections more than recorded (they failed)\n", replay.unmatched());
+    if (replay.replayed_connections() != replay.recorded_connections())
+        printf("Warning: %zu of %zu recorded connections were not used\n",
+               replay.recorded_connections() - replay.replayed_connections(),
+               replay.recorded_connections());
+    return 0;
+}
+
+
+static void usage(const char* prog)
+{
+    printf("Usage: %s [options]\n"
+           "  --devices N        number of virtual devices (%d)\n"
+           "  --interval S       report interval of each device, real seconds (%.0f)\n"
+           "  --jitter J         relative spread of device clocks (%.2f)\n"
+           "  --duration S       test duration, real seconds (%.0f)\n"
+           "  --server HOST:PORT gadget_central.py address (%s:%u)\n"
+           "  --fail-wifi P      probability of Wi-Fi down in each check (%.2f)\n"
+           "  --fail-connect P   probability of failed TCP connect (%.2f)\n"
+           "  --drop P           probability of lost response (%.2f)\n"
+           "  --min-delay MS     shortest delay() in virtual ms, saves CPU (%lu)\n"
+           "  --verbose          print Serial output of the devices\n"
+           "  --record FILE      record session of the first device (-DWITH_TRACE)\n"
+           "  --replay FILE      replay a recorded session, instead of the fleet\n"
+           "  --standin HOST=MODE  local stand-in server for HOST in DB_ENDPOINTS,\n"
+           "                     MODE: ok, slow:MS, down, blackhole, hang, flap:S (repeatable)\n",
+           prog, options.devices, options.interval, options.jitter, options.duration,
+           options.server_host.c_str(), options.server_port,
+           options.fail_wifi, options.fail_connect, options.drop, options.min_delay);
+}
+
+
+static bool parse_args(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--verbose") {
+            options.verbose = true;
+            continue;
+        }
+        if (arg == "-h" || arg == "--help" || i + 1 >= argc)
+            return false;
+        const char* value = argv[++i];
+        if (arg == "--devices")
+            options.devices = atoi(value);
+        else if (arg == "--interval")
+            options.interval = atof(value);
+        else if (arg == "--jitter")
+            options.jitter = atof(value);
+        else if (arg == "--duration")
+            options.duration = atof(value);
+        else if (arg == "--server") {
+            std::string server = value;
+            auto colon = server.rfind(':');
+            options.server_host = server.substr(0, colon);
+            if (colon != std::string::npos)
+                options.server_port = (uint16_t) atoi(server.c_str() + colon + 1);
+        } else if (arg == "--fail-wifi")
+            options.fail_wifi = atof(value);
+        else if (arg == "--fail-connect")
+            options.fail_connect = atof(value);
+        else if (arg == "--drop")
+            options.drop = atof(value);
+        else if (arg == "--min-delay")
+            options.min_delay = strtoul(value, nullptr, 10);
+        else if (arg == "--record")
+            options.record = value;
+        else if (arg == "--replay")
+            options.replay = value;
+        else if (arg == "--standin")
+            options.standins.push_back(value);
+        else
+            return false;
+    }
+    return options.devices > 0 && options.interval > 0.0 && options.duration > 0.0;
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (!parse_args(argc, argv)) {
+        usage(argv[0]);
+        return 1;
+    }
+#ifndef WITH_TRACE
+    if (!options.record.empty()) {
+        fprintf(stderr, "--record: build with -DWITH_TRACE\n");
+        return 1;
+    }
+#endif
+    if (!options.replay.empty())
+        return run_replay();
+    if (!StandIn::start_all())
+        return 1;
+
+    // One report cycle of sensors.cpp takes SEND_INTERVAL + 1 seconds of device time,
+    // the virtual clocks run faster to fit it into `interval`
+    const double cycle_ms = (SEND_INTERVAL + 1) * 1000.0;
+    const double speed = cycle_ms / (options.interval * 1000.0);
+    printf("Simulating %d devices, report interval %.1f s (clock speed %.1fx), server %s:%u\n",
+           options.devices, options.interval, speed,
+           options.server_host.c_str(), options.server_port);
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> spread(-options.jitter, options.jitter);
+    std::uniform_real_distribution<double> phase(0.0, options.interval);
+    std::vector<Device> devices(options.devices);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < options.devices; ++i) {
+        auto& dev = devices[i];
+        dev.id = i;
+        dev.rng.seed(i + 1);
+        dev.speed = speed * (1.0 + spread(rng));
+        threads.emplace_back(run_device, &dev, phase(rng));
+    }
+
+    auto start = Clock::now();
+    double elapsed = 0.0;
+    while (elapsed < options.duration) {
+        std::this_thread::sleep_for(std::chrono::duration<double>(
+                std::min(5.0, options.duration - elapsed)));
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        stats.report(stderr, elapsed, false);
+    }
+
+    running = false;
+    for (auto& thread : threads)
+        thread.join();
+
+    stats.report(stdout, elapsed, true);
+    return 0;
+}
@@ -0,0 +1,104 @@
+// Arduino.h - created by Radek Brich on 2026-10-19
+// Minimal Arduino core for the host build (fleet simulator)
+
+#ifndef GADGETS_SIM_ARDUINO_H
+#define GADGETS_SIM_ARDUINO_H
+
+#include "WString.h"
+#include "Print.h"
+#include "Stream.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+
+using std::min;
+using std::max;
+
+template <typename T, typename L, typename H>
+inline T constrain(T amt, L low, H high) { return amt < low ? low : (amt > high ? high : amt); }
+
+// Each virtual device runs in its own thread, see sensors.cpp
+#define DEVICE_STATE static thread_local
+#define SIM_HOST
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT 0x00
+#define OUTPUT 0x01
+#define INPUT_PULLUP 0x02
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#define LED_BUILTIN 2
+#define A0 17
+#define D0 16
+#define D1 5
+#define D2 4
+#define D3 0
+#define D4 2
+#define D5 14
+#define D6 12
+#define D7 13
+#define D8 15
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define PGM_P const char*
+#define FPSTR(p) (reinterpret_cast<const __FlashStringHelper*>(p))
+#define pgm_read_byte(addr) (*(const uint8_t*) (addr))
+#define memcpy_P memcpy
+#define strlen_P strlen
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define snprintf_P snprintf
+#define vsnprintf_P vsnprintf
+#define IRAM_ATTR
+#define ICACHE_RAM_ATTR
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogWrite(uint8_t pin, int val);
+
+void attachInterrupt(uint8_t pin, void (*handler)(), int mode);
+void detachInterrupt(uint8_t pin);
+inline uint8_t digitalPinToInterrupt(uint8_t pin) { return pin; }
+inline void interrupts() {}
+inline void noInterrupts() {}
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+class HardwareSerial: public Stream {
+public:
+    void begin(unsigned long baud) {}
+    explicit operator bool() const { return true; }
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+    int availableForWrite() override { return 128; }
+    void flush() override;
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+};
+
+extern HardwareSerial Serial;
+
+#endif // include guard
@@ -0,0 +1,27 @@
+// ESP8266WiFi.h - created by Radek Brich on 2026-10-19
+// ESP8266 Wi-Fi API for the host build
+
+#ifndef GADGETS_SIM_ESP8266WIFI_H
+#define GADGETS_SIM_ESP8266WIFI_H
+
+#include "Arduino.h"
+#include "IPAddress.h"
+#include "WiFiClient.h"
+#include "WiFiUdp.h"
+
+enum WiFiMode_t { WIFI_OFF = 0, WIFI_STA = 1, WIFI_AP = 2, WIFI_AP_STA = 3 };
+enum wl_status_t { WL_IDLE_STATUS = 0, WL_CONNECTED = 3, WL_DISCONNECTED = 6 };
+
+class ESP8266WiFiClass {
+public:
+    bool mode(WiFiMode_t m) { return true; }
+    wl_status_t begin(const char* ssid, const char* passphrase = nullptr) { return WL_CONNECTED; }
+    int8_t waitForConnectResult() { return WL_CONNECTED; }
+    bool isConnected();
+    IPAddress localIP() { return IPAddress(127, 0, 0, 1); }
+    int hostByName(const char* host, IPAddress& result);
+};
+
+extern ESP8266WiFiClass WiFi;
+
+#endif // include guard
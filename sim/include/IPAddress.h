@@ -0,0 +1,29 @@
+// IPAddress.h - created by Radek Brich on 2026-10-19
+// Arduino IPAddress for the host build
+
+#ifndef GADGETS_SIM_IPADDRESS_H
+#define GADGETS_SIM_IPADDRESS_H
+
+#include "WString.h"
+#include "Printable.h"
+#include <cstdint>
+
+class IPAddress: public Printable {
+public:
+    IPAddress() = default;
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+        : m_addr(uint32_t(a) | uint32_t(b) << 8 | uint32_t(c) << 16 | uint32_t(d) << 24) {}
+    explicit IPAddress(uint32_t addr) : m_addr(addr) {}
+
+    operator uint32_t() const { return m_addr; }
+    bool isSet() const { return m_addr != 0; }
+    uint8_t operator[](int index) const { return uint8_t(m_addr >> (index * 8)); }
+    bool fromString(const char* address);
+    String toString() const;
+    size_t printTo(Print& p) const override;
+
+private:
+    uint32_t m_addr = 0;  // network byte order
+};
+
+#endif // include guard
@@ -0,0 +1,48 @@
+// Print.h - created by Radek Brich on 2026-10-19
+// Arduino Print for the host build
+
+#ifndef GADGETS_SIM_PRINT_H
+#define GADGETS_SIM_PRINT_H
+
+#include "WString.h"
+#include "Printable.h"
+#include <cstddef>
+#include <cstdint>
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+class Print {
+public:
+    virtual ~Print() = default;
+
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size);
+    size_t write(const char* str) { return str ? write((const uint8_t*) str, strlen(str)) : 0; }
+    size_t write(const char* buffer, size_t size) { return write((const uint8_t*) buffer, size); }
+    virtual int availableForWrite() { return 0; }
+    virtual void flush() {}
+
+    size_t printf(const char* format, ...) __attribute__ ((format (printf, 2, 3)));
+    size_t printf_P(const char* format, ...) __attribute__ ((format (printf, 2, 3)));
+
+    size_t print(const __FlashStringHelper* str) { return write(reinterpret_cast<const char*>(str)); }
+    size_t print(const String& str) { return write(str.c_str(), str.length()); }
+    size_t print(const char* str) { return write(str); }
+    size_t print(char c) { return write((uint8_t) c); }
+    size_t print(unsigned char n, int base = DEC) { return print((unsigned long) n, base); }
+    size_t print(int n, int base = DEC) { return print((long) n, base); }
+    size_t print(unsigned int n, int base = DEC) { return print((unsigned long) n, base); }
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+    size_t print(double n, int digits = 2);
+    size_t print(const Printable& x) { return x.printTo(*this); }
+
+    template <typename T> size_t println(const T& arg) { size_t n = print(arg); return n + println(); }
+    template <typename T> size_t println(const T& arg, int base) { size_t n = print(arg, base); return n + println(); }
+    size_t println() { return write("\r\n"); }
+};
+
+#endif // include guard
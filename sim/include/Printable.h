@@ -0,0 +1,17 @@
+// Printable.h - created by Radek Brich on 2026-10-19
+// Arduino Printable for the host build
+
+#ifndef GADGETS_SIM_PRINTABLE_H
+#define GADGETS_SIM_PRINTABLE_H
+
+#include <cstddef>
+
+class Print;
+
+class Printable {
+public:
+    virtual ~Printable() = default;
+    virtual size_t printTo(Print& p) const = 0;
+};
+
+#endif // include guard
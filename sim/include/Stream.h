@@ -0,0 +1,28 @@
+// Stream.h - created by Radek Brich on 2026-10-19
+// Arduino Stream for the host build
+
+#ifndef GADGETS_SIM_STREAM_H
+#define GADGETS_SIM_STREAM_H
+
+#include "Print.h"
+
+class Stream: public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    virtual size_t readBytes(char* buffer, size_t length);
+    size_t readBytes(uint8_t* buffer, size_t length) { return readBytes((char*) buffer, length); }
+    size_t readBytesUntil(char terminator, char* buffer, size_t length);
+    String readStringUntil(char terminator);
+
+    void setTimeout(unsigned long timeout) { m_timeout = timeout; }
+
+protected:
+    int timedRead();
+
+    unsigned long m_timeout = 1000;
+};
+
+#endif // include guard
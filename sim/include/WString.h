@@ -0,0 +1,72 @@
+// WString.h - created by Radek Brich on 2026-10-19
+// Arduino String for the host build
+
+#ifndef GADGETS_SIM_WSTRING_H
+#define GADGETS_SIM_WSTRING_H
+
+#include <string>
+#include <cstring>
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper*>(string_literal))
+
+class String {
+public:
+    String() = default;
+    String(const char* cstr) : m_str(cstr ? cstr : "") {}
+    String(const __FlashStringHelper* str) : m_str(reinterpret_cast<const char*>(str)) {}
+    explicit String(char c) : m_str(1, c) {}
+    explicit String(int value, unsigned char base = 10);
+    explicit String(unsigned int value, unsigned char base = 10);
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+    explicit String(float value, unsigned char decimal_places = 2);
+    explicit String(double value, unsigned char decimal_places = 2);
+
+    unsigned int length() const { return (unsigned int) m_str.length(); }
+    const char* c_str() const { return m_str.c_str(); }
+    bool reserve(unsigned int size) { m_str.reserve(size); return true; }
+
+    bool concat(const String& str) { m_str += str.m_str; return true; }
+    bool concat(const char* cstr) { m_str += cstr; return true; }
+    bool concat(const char* cstr, unsigned int length) { m_str.append(cstr, length); return true; }
+    bool concat(const __FlashStringHelper* str) { return concat(reinterpret_cast<const char*>(str)); }
+    bool concat(char c) { m_str += c; return true; }
+    bool concat(int num) { return concat(String(num)); }
+    bool concat(unsigned int num) { return concat(String(num)); }
+    bool concat(long num) { return concat(String(num)); }
+    bool concat(unsigned long num) { return concat(String(num)); }
+    bool concat(float num) { return concat(String(num)); }
+    bool concat(double num) { return concat(String(num)); }
+
+    template <typename T> String& operator +=(const T& rhs) { concat(rhs); return *this; }
+
+    bool equals(const String& s) const { return m_str == s.m_str; }
+    bool equals(const char* cstr) const { return m_str == cstr; }
+    bool operator ==(const String& rhs) const { return equals(rhs); }
+    bool operator ==(const char* cstr) const { return equals(cstr); }
+    bool operator !=(const String& rhs) const { return !equals(rhs); }
+    bool operator !=(const char* cstr) const { return !equals(cstr); }
+
+    bool startsWith(const String& prefix) const { return m_str.compare(0, prefix.m_str.size(), prefix.m_str) == 0; }
+    bool endsWith(const String& suffix) const;
+    char charAt(unsigned int index) const { return index < m_str.size() ? m_str[index] : 0; }
+    char operator [](unsigned int index) const { return charAt(index); }
+    int indexOf(char ch, unsigned int from = 0) const;
+    int indexOf(const String& str, unsigned int from = 0) const;
+    int lastIndexOf(char ch) const;
+    String substring(unsigned int begin_index) const;
+    String substring(unsigned int begin_index, unsigned int end_index) const;
+    void trim();
+    long toInt() const;
+    float toFloat() const;
+
+private:
+    std::string m_str;
+};
+
+String operator +(const String& lhs, const String& rhs);
+String operator +(const String& lhs, const char* rhs);
+String operator +(const char* lhs, const String& rhs);
+
+#endif // include guard
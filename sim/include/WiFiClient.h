@@ -0,0 +1,67 @@
+// WiFiClient.h - created by Radek Brich on 2026-10-19
+// ESP8266 WiFiClient over POSIX sockets, each exchange is recorded in sim::Stats
+
+#ifndef GADGETS_SIM_WIFICLIENT_H
+#define GADGETS_SIM_WIFICLIENT_H
+
+#include "Arduino.h"
+#include "IPAddress.h"
+#include <chrono>
+#include <string>
+
+class WiFiClient: public Stream {
+public:
+    WiFiClient() { setTimeout(5000); }  // connect timeout, as on ESP8266
+    ~WiFiClient() override { stop(); }
+    WiFiClient(const WiFiClient&) = delete;
+    WiFiClient& operator =(const WiFiClient&) = delete;
+
+    int connect(IPAddress ip, uint16_t port);
+    int connect(const char* host, uint16_t port);
+    int connect(const String& host, uint16_t port) { return connect(host.c_str(), port); }
+    uint8_t connected();
+    explicit operator bool() { return connected(); }
+    void stop();
+    void stop(unsigned int max_wait_ms) { stop(); }  // nothing to flush here
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+    int availableForWrite() override;
+
+    int available() override;
+    int read() override;
+    int read(uint8_t* buffer, size_t size);
+    int read(char* buffer, size_t size) { return read((uint8_t*) buffer, size); }
+    int peek() override;
+
+    IPAddress remoteIP() const { return m_remote_ip; }
+    void setNoDelay(bool nodelay);
+    static void setDefaultNoDelay(bool nodelay) {}
+
+private:
+    int open(IPAddress ip, uint16_t port, const char* host);
+    bool fill(bool wait);
+    void record();
+    // Statistics key, with the host when there are stand-ins (sim::StandIn)
+    std::string key(const std::string& request) const;
+
+    int m_fd = -1;
+    const char* m_host = nullptr;  // requested, not resolved
+    bool m_eof = false;
+    IPAddress m_remote_ip;
+    uint8_t m_rx_buf[1460];
+    size_t m_rx_pos = 0;
+    size_t m_rx_len = 0;
+
+    // recorded exchange
+    std::chrono::steady_clock::time_point m_start;
+    char m_request[48] = {};    // "GET /control/..." (truncated)
+    size_t m_request_len = 0;
+    char m_status_line[16] = {};  // "HTTP/1.1 200"
+    size_t m_status_len = 0;
+    bool m_drop_pending = false;  // injected failure, drop before response
+    bool m_dropped = false;
+};
+
+#endif // include guard
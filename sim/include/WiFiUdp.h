@@ -0,0 +1,32 @@
+// WiFiUdp.h - created by Radek Brich on 2026-10-19
+// ESP8266 WiFiUDP over POSIX sockets
+
+#ifndef GADGETS_SIM_WIFIUDP_H
+#define GADGETS_SIM_WIFIUDP_H
+
+#include "Arduino.h"
+#include "IPAddress.h"
+
+class WiFiUDP: public Print {
+public:
+    ~WiFiUDP() override { stop(); }
+
+    uint8_t begin(uint16_t port);
+    void stop();
+
+    int beginPacket(IPAddress ip, uint16_t port);
+    int beginPacket(const char* host, uint16_t port);
+    int endPacket();
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+
+private:
+    int m_fd = -1;
+    IPAddress m_dest_ip;
+    uint16_t m_dest_port = 0;
+    uint8_t m_tx_buf[1500];
+    size_t m_tx_len = 0;
+};
+
+#endif // include guard
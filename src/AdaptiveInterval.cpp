@@ -0,0 +1,78 @@
+// AdaptiveInterval.cpp - created by Radek Brich on 2026-10-19
+
+#include "AdaptiveInterval.h"
+#include <Arduino.h>
+
+
+void AdaptiveInterval::set_bounds(int min_interval, int max_interval)
+{
+    if (min_interval <= 0 || max_interval < min_interval)
+        return;
+    m_min = min_interval;
+    m_max = max_interval;
+    m_interval = constrain(m_interval, m_min, m_max);
+}
+
+
+float AdaptiveInterval::threshold(const char* measurement, float value)
+{
+    // Smallest change worth reporting, roughly the sensor's useful resolution
+    if (strcmp_P(measurement, PSTR("temperature")) == 0)
+        return 0.2f;    // degC
+    if (strcmp_P(measurement, PSTR("humidity")) == 0)
+        return 1.f;     // %
+    if (strcmp_P(measurement, PSTR("pressure")) == 0)
+        return 0.5f;    // hPa
+    if (strcmp_P(measurement, PSTR("moisture")) == 0)
+        return 2.f;     // %
+    // 2% of current value for the others
+    return max(fabsf(value) * 0.02f, 1.f);
+}
+
+
+void AdaptiveInterval::sample(const char* measurement, const char* sensor, float value)
+{
+    Series* series = nullptr;
+    for (int i = 0; i != m_series_count; ++i) {
+        // the names are string literals, comparing pointers is enough
+        if (m_series[i].measurement == measurement && m_series[i].sensor == sensor) {
+            series = &m_series[i];
+            break;
+        }
+    }
+    if (series == nullptr) {
+        if (m_series_count == max_series)
+            return;
+        series = &m_series[m_series_count++];
+        *series = {measurement, sensor, value, value, false};
+    }
+
+    series->value = value;
+    if (!series->has_reported
+    || fabsf(value - series->reported) >= threshold(measurement, series->reported))
+        m_changed = true;
+}
+
+
+bool AdaptiveInterval::due(int elapsed) const
+{
+    return elapsed >= m_interval || (m_changed && elapsed >= m_min);
+}
+
+
+void AdaptiveInterval::restart()
+{
+    // Without any values (e.g. NO_SENSORS), keep the interval
+    if (m_series_count != 0) {
+        if (m_changed)
+            m_interval = max(m_interval / 2, m_min);
+        else
+            m_interval = min(m_interval * 2, m_max);
+    }
+
+    for (int i = 0; i != m_series_count; ++i) {
+        m_series[i].reported = m_series[i].value;
+        m_series[i].has_reported = true;
+    }
+    m_changed = false;
+}
@@ -0,0 +1,54 @@
+// AdaptiveInterval.h - created by Radek Brich on 2026-10-19
+
+#ifndef GADGETS_ADAPTIVEINTERVAL_H
+#define GADGETS_ADAPTIVEINTERVAL_H
+
+// Report interval driven by signal dynamics.
+//
+// Each sampled value is compared with the last reported one. A change
+// over the measurement's threshold (see `threshold()`) is significant:
+// - a significant change makes the report due, after `min_interval`
+// - each report with a significant change halves the interval,
+//   each report without one doubles it, up to `max_interval`
+class AdaptiveInterval {
+public:
+    AdaptiveInterval(int min_interval, int interval, int max_interval) noexcept
+        : m_min(min_interval), m_max(max_interval), m_interval(interval) {}
+
+    // Bounds in seconds, e.g. from control command "interval <min> <max>"
+    void set_bounds(int min_interval, int max_interval);
+
+    int interval() const { return m_interval; }
+
+    // Feed current value (call after each read)
+    void sample(const char* measurement, const char* sensor, float value);
+
+    // Report should be sent now, `elapsed` is secs since the last attempt
+    bool due(int elapsed) const;
+
+    // Report was delivered - adjust the interval, remember the values
+    // (a failed one keeps them, with the change still to report)
+    void restart();
+
+private:
+    static float threshold(const char* measurement, float value);
+
+    struct Series {
+        const char* measurement;
+        const char* sensor;
+        float value;
+        float reported;
+        bool has_reported;
+    };
+
+    static constexpr int max_series = 8;
+    Series m_series[max_series];
+    int m_series_count = 0;
+    bool m_changed = false;    // significant change since last report
+
+    int m_min;
+    int m_max;
+    int m_interval;
+};
+
+#endif // include guard
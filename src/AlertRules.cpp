@@ -0,0 +1,140 @@
+// AlertRules.cpp - created by Radek Brich on 2026-10-19
+
+#include "config.h"
+#include "AlertRules.h"
+#include "Log.h"
+#include <Arduino.h>
+
+#ifdef ALERT_RULES
+static const AlertRules::Rule s_rules[] = { ALERT_RULES };
+static constexpr size_t s_count = sizeof(s_rules) / sizeof(s_rules[0]);
+static_assert(s_count <= AlertRules::max_rules, "ALERT_RULES: too many rules");
+#else
+static const AlertRules::Rule* s_rules = nullptr;
+static constexpr size_t s_count = 0;
+#endif
+
+static const char* const s_kind_names[] = {"above", "below", "rising", "falling"};
+
+
+AlertRules::AlertRules() noexcept
+    : m_rules(s_rules), m_count(uint8_t(s_count))
+{}
+
+
+void AlertRules::sample(const char* measurement, const char* sensor, float value)
+{
+    for (uint8_t i = 0; i != m_count; ++i) {
+        const Rule& rule = m_rules[i];
+        State& state = m_state[i];
+        if (strcmp(rule.measurement, measurement) != 0)
+            continue;
+        if (state.sensor == nullptr) {
+            if (rule.sensor != nullptr && strcmp(rule.sensor, sensor) != 0)
+                continue;
+            state.sensor = sensor;
+        } else if (state.sensor != sensor)
+            continue;   // the names are string literals, see AdaptiveInterval
+        if (!check(rule, state, value))
+            continue;
+        state.pending = true;
+        m_pending = true;
+        LOG_WARN("* Alert: %s %s %s %.2f (%.2f)\n", measurement, sensor,
+                 s_kind_names[rule.kind], rule.threshold, state.value);
+    }
+}
+
+
+bool AlertRules::check(const Rule& rule, State& state, float value)
+{
+    // Compare the value, or its change over the window
+    float x = value;
+    if (rule.kind == Rising || rule.kind == Falling) {
+        auto now = millis();
+        uint8_t oldest = state.history_len == 4 ? state.history_pos : 0;
+        x = state.history_len == 0 ? 0.f : value - state.history[oldest];
+        if (state.history_len == 0 || now - state.history_time >= ALERT_RATE_WINDOW * 250ul) {
+            state.history[state.history_pos] = value;
+            state.history_pos = (state.history_pos + 1) % 4;
+            if (state.history_len != 4)
+                ++state.history_len;
+            state.history_time = now;
+        }
+    }
+
+    // Below / Falling mirrored, so it's always "x over threshold"
+    float threshold = rule.threshold;
+    float sign = 1.f;
+    if (rule.kind == Below)
+        sign = -1.f, threshold = -threshold;
+    if (rule.kind == Falling)
+        sign = -1.f;
+
+    if (state.active) {
+        if (sign * x < threshold - rule.hysteresis)
+            state.active = false;
+        return false;
+    }
+    if (sign * x < threshold)
+        return false;
+    state.active = true;
+    state.value = x;
+    return true;
+}
+
+
+bool AlertRules::due() const
+{
+    auto now = millis();
+    return m_pending
+        && (!m_uploaded || now - m_upload_time >= ALERT_MIN_INTERVAL * 1000ul)
+        && (!m_failed || now - m_failed_time >= ALERT_RETRY_INTERVAL * 1000ul);
+}
+
+
+void AlertRules::restart()
+{
+    // Only a report with alerts counts for the rate limit
+    if (!m_pending)
+        return;
+    for (uint8_t i = 0; i != m_count; ++i)
+        m_state[i].pending = false;
+    m_pending = false;
+    m_failed = false;
+    m_uploaded = true;
+    m_upload_time = millis();
+}
+
+
+void AlertRules::failed()
+{
+    // Don't retry on each loop pass while the server is down
+    if (!m_pending)
+        return;
+    m_failed = true;
+    m_failed_time = millis();
+}
+
+
+void AlertRules::output_to_database(Print& query)
+{
+    if (!m_pending)
+        return;
+    for (uint8_t i = 0; i != m_count; ++i) {
+        State& state = m_state[i];
+        if (!state.pending)
+            continue;
+        const Rule& rule = m_rules[i];
+        query.print(F("alert,measurement="));
+        query.print(rule.measurement);
+        query.print(F(",sensor="));
+        query.print(state.sensor);
+        query.print(F(",rule="));
+        query.print(s_kind_names[rule.kind]);
+        query.print(F("," DEVICE_TAGS " value="));
+        query.print(state.value);
+        query.print(F(",threshold="));
+        query.print(rule.threshold);
+        query.print('\n');
+    }
+}
@@ -0,0 +1,89 @@
+// AlertRules.h - created by Radek Brich on 2026-10-19
+
+#ifndef GADGETS_ALERTRULES_H
+#define GADGETS_ALERTRULES_H
+
+#include <Print.h>
+#include <stdint.h>
+
+// Shortest time between uploads triggered by alerts, in seconds
+#ifndef ALERT_MIN_INTERVAL
+#define ALERT_MIN_INTERVAL 60
+#endif
+
+// Retry of an alert upload which failed, in seconds
+#ifndef ALERT_RETRY_INTERVAL
+#define ALERT_RETRY_INTERVAL 10
+#endif
+
+// Rising / Falling rules compare with the value from this many seconds ago
+#ifndef ALERT_RATE_WINDOW
+#define ALERT_RATE_WINDOW 60
+#endif
+
+// Edge alerts: rules on the sampled values, ALERT_RULES in config.h:
+//   #define ALERT_RULES {"moisture", "Generic", AlertRules::Below, 25, 5}, ...
+//
+// A rule fires when its value crosses the threshold: Above / Below compare
+// the value, Rising / Falling its change over ALERT_RATE_WINDOW. Then it
+// waits until the value gets back past threshold -+ hysteresis.
+// A fired rule makes the report due at once (rate limited, see
+// ALERT_MIN_INTERVAL) and adds an "alert" point to it. The point stays
+// pending until a report with it is delivered.
+class AlertRules {
+public:
+    enum Kind: uint8_t { Above, Below, Rising, Falling };
+
+    struct Rule {
+        const char* measurement;
+        const char* sensor;     // nullptr = the first sensor with the measurement
+        Kind kind;
+        float threshold;        // value, or change per ALERT_RATE_WINDOW
+        float hysteresis;
+    };
+
+    static constexpr uint8_t max_rules = 8;
+
+    AlertRules() noexcept;
+
+    // Feed current value (call after each read)
+    void sample(const char* measurement, const char* sensor, float value);
+
+    // An alert is waiting for upload, and the rate limit allows it
+    bool due() const;
+
+    // Points of the fired rules, pending until `restart()`
+    void output_to_database(Print& query);
+
+    // Report with the points was delivered - clear them, start the rate limit
+    void restart();
+
+    // Report with the points failed - keep them, retry after ALERT_RETRY_INTERVAL
+    void failed();
+
+private:
+    struct State {
+        const char* sensor = nullptr;   // bound on first sample
+        bool active = false;            // fired, waiting for re-arm
+        bool pending = false;           // fired, not uploaded yet
+        float value = 0.f;              // value (or change) which fired
+        // Rising / Falling: values at quarters of ALERT_RATE_WINDOW
+        float history[4] = {};
+        uint8_t history_len = 0;
+        uint8_t history_pos = 0;
+        unsigned long history_time = 0; // millis() of the newest
+    };
+
+    bool check(const Rule& rule, State& state, float value);
+
+    const Rule* m_rules;
+    uint8_t m_count;
+    State m_state[max_rules];
+    bool m_pending = false;
+    bool m_uploaded = false;            // an alert upload was made
+    bool m_failed = false;              // the last attempt failed
+    unsigned long m_upload_time = 0;    // millis() of the last upload
+    unsigned long m_failed_time = 0;    // millis() of the failed attempt
+};
+
+#endif // include guard
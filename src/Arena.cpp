@@ -0,0 +1,62 @@
+// Arena.cpp - created by Radek Brich on 2026-10-19
+
+#include "Arena.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+
+void* Arena::alloc(size_t size, size_t align)
+{
+    size_t begin = (m_used + align - 1) & ~(align - 1);
+    if (begin + size > capacity())
+        return nullptr;
+    m_used = begin + size;
+    if (m_used > m_peak)
+        m_peak = m_used;
+    return m_buffer + begin;
+}
+
+
+const char* Arena::printf_P(PGM_P format, ...)
+{
+    char* begin = (char*) m_buffer + m_used;
+    size_t avail = capacity() - m_used;
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf_P(begin, avail, format, args);
+    va_end(args);
+    if (len < 0 || size_t(len) >= avail)
+        return nullptr;
+    // formatted in place, now commit it
+    return (const char*) alloc(len + 1, 1);
+}
+
+
+size_t Arena::Writer::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+
+size_t Arena::Writer::write(const uint8_t* buffer, size_t size)
+{
+    // keep one byte for terminating zero
+    size_t avail = capacity() - m_arena.m_used - m_length - 1;
+    if (size > avail) {
+        m_overflow = true;
+        size = avail;
+    }
+    memcpy(m_arena.m_buffer + m_arena.m_used + m_length, buffer, size);
+    m_length += size;
+    return size;
+}
+
+
+const char* Arena::Writer::finish()
+{
+    auto* str = (char*) m_arena.m_buffer + m_arena.m_used;
+    str[m_length] = '\0';
+    m_arena.alloc(m_length + 1, 1);
+    return str;
+}
@@ -0,0 +1,60 @@
+// Arena.h - created by Radek Brich on 2026-10-19
+
+#ifndef GADGETS_ARENA_H
+#define GADGETS_ARENA_H
+
+#include <Arduino.h>
+#include <Print.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef ARENA_SIZE
+#define ARENA_SIZE 2048
+#endif
+
+// Bump allocator for transient data of one send cycle.
+// Everything is released at once by `reset()` at the start of the cycle.
+class Arena {
+public:
+    // Returns nullptr when the arena is full
+    void* alloc(size_t size, size_t align = 8);
+
+    // Formatted string in the arena, nullptr when it doesn't fit.
+    // The format is in flash: `arena.printf_P(PSTR("%d"), n)`
+    const char* printf_P(PGM_P format, ...) __attribute__ ((format (printf, 2, 3)));
+
+    void reset() { m_used = 0; }
+
+    size_t used() const { return m_used; }
+    size_t peak() const { return m_peak; }
+    static constexpr size_t capacity() { return ARENA_SIZE; }
+
+    // Print into the free space of the arena, e.g. for `output_to_database()`.
+    // Nothing else can be allocated until `finish()`.
+    class Writer: public Print {
+    public:
+        explicit Writer(Arena& arena) : m_arena(arena) {}
+
+        size_t write(uint8_t c) override;
+        size_t write(const uint8_t* buffer, size_t size) override;
+        using Print::write;
+
+        // Terminate the string and commit it to the arena
+        const char* finish();
+
+        size_t length() const { return m_length; }
+        bool overflow() const { return m_overflow; }
+
+    private:
+        Arena& m_arena;
+        size_t m_length = 0;
+        bool m_overflow = false;
+    };
+
+private:
+    uint8_t m_buffer[ARENA_SIZE] __attribute__ ((aligned (8)));
+    size_t m_used = 0;
+    size_t m_peak = 0;
+};
+
+#endif // include guard
@@ -2,6 +2,7 @@
 
 #include "Display.h"
 #include <stdarg.h>
+#include <string.h>
 
 #ifdef WITH_OLED
 
@@ -15,70 +16,132 @@ static unsigned char WIFI_icon_bits[] = {
 
 void Display::begin()
 {
-    m_oled.begin(SSD1306_SWITCHCAPVCC, 0x3C);
-    m_oled.dim(1);
-    m_oled.setTextSize(1);
-    m_oled.setTextColor(WHITE);
-    m_oled.setTextWrap(0);
-    m_oled.display();
+    i2c_bus.run(m_device, [this] {
+        m_oled.begin(SSD1306_SWITCHCAPVCC, m_device.address());
+        m_oled.dim(1);
+        return true;
+    });
+    m_canvas.setTextSize(1);
+    m_canvas.setTextColor(WHITE);
+    m_canvas.setTextWrap(0);
+
+    // Panel RAM is unknown (or the library's splash screen), send all
+    memset(m_sent, 0xff, sizeof(m_sent));
+    clear();
+    display();
 }
 
 
 void Display::clear()
 {
-    m_oled.clearDisplay();
+    m_canvas.fillScreen(BLACK);
 }
 
 
 void Display::display()
 {
-    m_oled.display();
+    // GFXcanvas1 is row-major, MSB first
+    const uint8_t* canvas = m_canvas.getBuffer();
+    constexpr int stride = (width + 7) / 8;
+    for (int page = 0; page != pages; ++page) {
+        for (int x = 0; x != width; ++x) {
+            uint8_t column = 0;
+            for (int bit = 0; bit != 8; ++bit) {
+                if (canvas[(page * 8 + bit) * stride + x / 8] & (0x80 >> (x & 7)))
+                    column |= 1 << bit;
+            }
+            m_frame[page][x] = column;
+        }
+        if (memcmp(m_frame[page], m_sent[page], width) != 0)
+            m_dirty |= 1 << page;
+    }
+}
+
+
+void Display::loop()
+{
+    int budget = DISPLAY_PAGES_PER_LOOP;
+    for (int page = 0; page != pages && m_dirty != 0 && budget != 0; ++page) {
+        if (!(m_dirty & (1 << page)))
+            continue;
+        // On error, the page stays dirty and is sent again
+        if (send_page(page))
+            m_dirty &= ~(1 << page);
+        --budget;
+    }
+}
+
+
+// Send the changed columns of one page: address window, then data
+bool Display::send_page(int page)
+{
+    const uint8_t* frame = m_frame[page];
+    const uint8_t* sent = m_sent[page];
+    int first = 0;
+    int last = width - 1;
+    while (first <= last && frame[first] == sent[first])
+        ++first;
+    while (last >= first && frame[last] == sent[last])
+        --last;
+    if (first > last)
+        return true;
+
+    const uint8_t window[] = {
+        SSD1306_COLUMNADDR, uint8_t(column_offset + first), uint8_t(column_offset + last),
+        SSD1306_PAGEADDR, uint8_t(page), uint8_t(page),
+    };
+    if (!i2c_bus.write(m_device, 0x00, window, sizeof(window)))  // Co = 0, D/C = 0: commands
+        return false;
+    if (!i2c_bus.write(m_device, 0x40, frame + first, last - first + 1))  // D/C = 1: data
+        return false;
+    memcpy(m_sent[page] + first, frame + first, last - first + 1);
+    return true;
 }
 
 
 void Display::drawWifiIcon()
 {
-    m_oled.drawXBitmap(0, 0, WIFI_icon_bits, WIFI_icon_width, WIFI_icon_height, WHITE);
+    m_canvas.drawXBitmap(0, 0, WIFI_icon_bits, WIFI_icon_width, WIFI_icon_height, WHITE);
 }
 
 
 void Display::drawTimer(int seconds)
 {
-    m_oled.setCursor(14, 2);
-    m_oled.printf("T-%d:%02d\n", seconds / 60, seconds % 60);
+    m_canvas.setCursor(14, 2);
+    m_canvas.printf_P(PSTR("T-%d:%02d\n"), seconds / 60, seconds % 60);
 }
 
 
 void Display::drawStar()
 {
-    m_oled.setCursor(54, 2);
-    m_oled.print("*");
+    m_canvas.setCursor(54, 2);
+    m_canvas.print('*');
 }
 
 
-void Display::drawText(int line, const char *text)
+void Display::drawText(int line, const __FlashStringHelper *text)
 {
-    m_oled.setCursor(0, line * 9 + 4);
-    m_oled.print(text);
+    m_canvas.setCursor(0, line * 9 + 4);
+    m_canvas.print(text);
 }
 
 
-void Display::appendText(const char *text)
+void Display::appendText(const __FlashStringHelper *text)
 {
-    m_oled.print(text);
+    m_canvas.print(text);
 }
 
 
-void Display::drawValue(int line, const char *format, double value)
+void Display::drawValue(int line, PGM_P format, double value)
 {
-    m_oled.setCursor(0, line * 9 + 4);
-    m_oled.printf(format, value);
+    m_canvas.setCursor(0, line * 9 + 4);
+    m_canvas.printf_P(format, value);
 }
 
 
-void Display::appendValue(const char *format, double value)
+void Display::appendValue(PGM_P format, double value)
 {
-    m_oled.printf(format, value);
+    m_canvas.printf_P(format, value);
 }
 
 
@@ -87,12 +150,13 @@ void Display::appendValue(const char *format, double value)
 void Display::begin() {}
 void Display::clear() {}
 void Display::display() {}
+void Display::loop() {}
 void Display::drawWifiIcon() {}
 void Display::drawTimer(int seconds) {}
 void Display::drawStar() {}
-void Display::drawText(int line, const char *text) {}
-void Display::appendText(const char *text) {}
-void Display::drawValue(int line, const char *format, double value) {}
-void Display::appendValue(const char *format, double value) {}
+void Display::drawText(int line, const __FlashStringHelper *text) {}
+void Display::appendText(const __FlashStringHelper *text) {}
+void Display::drawValue(int line, PGM_P format, double value) {}
+void Display::appendValue(PGM_P format, double value) {}
 
 #endif
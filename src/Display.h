@@ -3,12 +3,19 @@
 #ifndef GADGETS_DISPLAY_H
 #define GADGETS_DISPLAY_H
 
+#include <Arduino.h>
+
 #ifdef WITH_OLED
-#include <Wire.h>
+#include "I2CBus.h"
 #include <Adafruit_GFX.h>
 #include <Adafruit_SSD1306.h>
 
 #define OLED_RESET 0  // GPIO0
+
+// Frame update is spread over loop passes, this many pages (8 rows) per `loop()`
+#ifndef DISPLAY_PAGES_PER_LOOP
+#define DISPLAY_PAGES_PER_LOOP 2
+#endif
 #endif
 
 
@@ -17,22 +24,43 @@ public:
     void begin();
 
     void clear();
+
+    // Finish the frame, `loop()` sends it to the panel
     void display();
 
+    // Send a part of the frame (only changed pages), call this often
+    void loop();
+
     // Status bar (line 0):
     void drawWifiIcon();
     void drawTimer(int seconds);
     void drawStar();
 
-    // Text/value lines (1 .. 4):
-    void drawText(int line, const char *text);
-    void appendText(const char *text);
-    void drawValue(int line, const char *format, double value);
-    void appendValue(const char *format, double value);
+    // Text/value lines (1 .. 4), strings in flash:
+    // `drawText(1, F("Conn "))`, `drawValue(1, PSTR("%.2f degC"), t)`
+    void drawText(int line, const __FlashStringHelper *text);
+    void appendText(const __FlashStringHelper *text);
+    void drawValue(int line, PGM_P format, double value);
+    void appendValue(PGM_P format, double value);
 
 private:
 #ifdef WITH_OLED
-    Adafruit_SSD1306 m_oled {OLED_RESET};
+    // Wemos OLED shield: 64x48, in the middle of 128x64 controller RAM
+    static constexpr int width = 64;
+    static constexpr int height = 48;
+    static constexpr int pages = height / 8;
+    static constexpr int column_offset = 32;
+
+    bool send_page(int page);
+
+    Adafruit_SSD1306 m_oled {OLED_RESET};   // controller init
+    GFXcanvas1 m_canvas {width, height};    // drawing
+    I2CBus::Device m_device {"SSD1306", 0x3C, 400000};
+
+    // Controller format: one byte = 8 rows of a column, LSB on top
+    uint8_t m_frame[pages][width] = {};     // finished by display()
+    uint8_t m_sent[pages][width] = {};      // on the panel
+    uint8_t m_dirty = 0;                    // pages to send (bit mask)
 #endif
 };
 
@@ -0,0 +1,129 @@
+// Endpoints.cpp - created by Radek Brich on 2026-10-19
+
+#include "config.h"
+#include "Endpoints.h"
+#include "Log.h"
+
+#ifndef DB_ENDPOINTS
+#define DB_ENDPOINTS {DB_HOST, DB_PORT}
+#endif
+
+static const Endpoints::Endpoint s_endpoints[] = { DB_ENDPOINTS };
+
+static constexpr size_t s_count = sizeof(s_endpoints) / sizeof(s_endpoints[0]);
+static_assert(s_count <= Endpoints::max_endpoints, "DB_ENDPOINTS: too many endpoints");
+
+
+Endpoints::Endpoints() noexcept
+    : m_endpoints(s_endpoints), m_count(uint8_t(s_count))
+{}
+
+
+bool Endpoints::available(uint8_t i, unsigned long now) const
+{
+    const Health& h = m_health[i];
+    return h.backoff == 0 || now - h.failed_at >= h.backoff;
+}
+
+
+unsigned long Endpoints::remaining(uint8_t i, unsigned long now) const
+{
+    const Health& h = m_health[i];
+    return available(i, now) ? 0 : h.backoff - (now - h.failed_at);
+}
+
+
+bool Endpoints::connect(HttpClient& client)
+{
+    m_current = -1;
+    uint8_t tried = 0;  // bit mask
+    for (;;) {
+        // Fastest endpoint not tried yet, out of back-off.
+        // No history counts as fastest - it gets measured.
+        auto now = millis();
+        int8_t best = -1;
+        for (uint8_t i = 0; i != m_count; ++i) {
+            if ((tried & (1 << i)) || !available(i, now))
+                continue;
+            if (best == -1 || m_health[i].latency < m_health[best].latency)
+                best = int8_t(i);
+        }
+        if (best == -1 && tried == 0) {
+            // All backing off - still try the one which comes back first,
+            // a single endpoint mustn't skip reports
+            for (uint8_t i = 0; i != m_count; ++i)
+                if (best == -1 || remaining(i, now) < remaining(best, now))
+                    best = int8_t(i);
+            LOG_WARN("* All endpoints backing off, trying %s:%u\n",
+                     m_endpoints[best].host, m_endpoints[best].port);
+        }
+        if (best == -1)
+            return false;
+        tried |= 1 << best;
+
+        const Endpoint& ep = m_endpoints[best];
+        uint32_t latency = m_health[best].latency;
+        unsigned long timeout = ENDPOINT_CONNECT_TIMEOUT;
+        if (latency != 0)
+            timeout = constrain(4ul * latency, (unsigned long) ENDPOINT_CONNECT_TIMEOUT_MIN, timeout);
+        m_start = millis();
+        if (client.connect(ep.host, ep.port, timeout)) {
+            m_current = best;
+            return true;
+        }
+        client.stop();
+        failed(best);
+    }
+}
+
+
+void Endpoints::done(bool ok)
+{
+    if (m_current == -1)
+        return;
+    uint8_t i = uint8_t(m_current);
+    m_current = -1;
+    if (!ok) {
+        failed(i);
+        return;
+    }
+    Health& h = m_health[i];
+    uint32_t ms = max(millis() - m_start, 1ul);
+    h.latency = h.latency == 0 ? ms : (3 * h.latency + ms) / 4;
+    if (h.failures != 0)
+        LOG_INFO("* Endpoint %s:%u back after %u failures\n",
+                 m_endpoints[i].host, m_endpoints[i].port, h.failures);
+    h.failures = 0;
+    h.backoff = 0;
+}
+
+
+void Endpoints::failed(uint8_t i)
+{
+    Health& h = m_health[i];
+    if (h.failures != UINT16_MAX)
+        ++h.failures;
+    unsigned long backoff = ENDPOINT_BACKOFF_MIN;
+    for (uint16_t n = 1; n < h.failures && backoff < ENDPOINT_BACKOFF_MAX; ++n)
+        backoff *= 2;
+    backoff = min(backoff, (unsigned long) ENDPOINT_BACKOFF_MAX);
+    h.backoff = backoff - backoff / 4 + random(backoff / 2 + 1);
+    h.failed_at = millis();
+    LOG_WARN("* Endpoint %s:%u failed (%u in a row), back off %lu s\n",
+             m_endpoints[i].host, m_endpoints[i].port, h.failures, h.backoff / 1000);
+}
+
+
+void Endpoints::report(Print& out) const
+{
+    auto now = millis();
+    for (uint8_t i = 0; i != m_count; ++i) {
+        const Health& h = m_health[i];
+        out.printf_P(PSTR("[endpoint] %s:%u: latency %lu ms, %u failures"),
+                     m_endpoints[i].host, m_endpoints[i].port,
+                     (unsigned long) h.latency, h.failures);
+        if (!available(i, now))
+            out.printf_P(PSTR(", retry in %lu s"), remaining(i, now) / 1000);
+        out.print('\n');
+    }
+}
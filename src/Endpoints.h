@@ -0,0 +1,79 @@
+// Endpoints.h - created by Radek Brich on 2026-10-19
+
+#ifndef GADGETS_ENDPOINTS_H
+#define GADGETS_ENDPOINTS_H
+
+#include "HttpClient.h"
+#include <Arduino.h>
+#include <Print.h>
+
+// Back-off of a failed endpoint, ms: the first one, doubled with each
+// further failure up to the max
+#ifndef ENDPOINT_BACKOFF_MIN
+#define ENDPOINT_BACKOFF_MIN 30000
+#endif
+#ifndef ENDPOINT_BACKOFF_MAX
+#define ENDPOINT_BACKOFF_MAX 900000
+#endif
+
+// Connect timeout of an endpoint without latency history, ms. A known one
+// gets 4x its average latency (at least ENDPOINT_CONNECT_TIMEOUT_MIN).
+#ifndef ENDPOINT_CONNECT_TIMEOUT
+#define ENDPOINT_CONNECT_TIMEOUT 5000
+#endif
+#ifndef ENDPOINT_CONNECT_TIMEOUT_MIN
+#define ENDPOINT_CONNECT_TIMEOUT_MIN 500
+#endif
+
+// Upload endpoints (instances of the C&C server), DB_ENDPOINTS in config.h:
+//   #define DB_ENDPOINTS {"server.lan", 8086}, {"backup.lan", 8086}
+// Without it, DB_HOST:DB_PORT is the only one.
+//
+// Each endpoint keeps a moving average of its request latency (connect ..
+// response) and a count of consecutive failures. A failure puts it into
+// back-off, with +-25 % jitter - the devices don't all come back at once
+// after a server restart. `connect()` tries the endpoints out of back-off,
+// fastest first, so a dead one doesn't cost a connect timeout each cycle.
+// When all are backing off, it tries the one whose back-off ends first.
+class Endpoints {
+public:
+    struct Endpoint {
+        const char* host;
+        uint16_t port;
+    };
+
+    static constexpr uint8_t max_endpoints = 4;
+
+    Endpoints() noexcept;
+
+    // Connect to the fastest endpoint out of back-off, fail over to the next
+    // ones. False when none connects.
+    bool connect(HttpClient& client);
+
+    // Outcome of the request on the endpoint from the last `connect()`
+    // - `ok` means the server responded (any status below 500)
+    void done(bool ok);
+
+    // State of each endpoint
+    void report(Print& out) const;
+
+private:
+    struct Health {
+        uint32_t latency = 0;       // moving average, ms (0 = no history)
+        uint16_t failures = 0;      // consecutive
+        unsigned long failed_at = 0;  // millis() of the last failure
+        unsigned long backoff = 0;    // ms from `failed_at`, 0 = healthy
+    };
+
+    bool available(uint8_t i, unsigned long now) const;
+    unsigned long remaining(uint8_t i, unsigned long now) const;  // of back-off, ms
+    void failed(uint8_t i);
+
+    const Endpoint* m_endpoints;
+    uint8_t m_count;
+    Health m_health[max_endpoints];
+    int8_t m_current = -1;          // connected by the last `connect()`
+    unsigned long m_start = 0;      // millis() of its connect
+};
+
+#endif // include guard
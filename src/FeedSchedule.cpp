@@ -0,0 +1,216 @@
+// FeedSchedule.cpp - created by Radek Brich on 2026-10-19
+
+#include "FeedSchedule.h"
+#include "HeapCheck.h"
+#include "Log.h"
+#include <EEPROM.h>
+#include <stddef.h>
+#include <string.h>
+
+// Any time before this is not from SNTP (2020-01-01)
+static constexpr time_t valid_time = 1577836800;
+
+// Seconds missed while the loop was blocked (e.g. connecting) are caught up,
+// a longer gap is a clock step - the feedings in it are skipped
+static constexpr time_t max_catch_up = 300;
+
+// Day names in the order of tm_wday
+static const char day_names[] PROGMEM = "sumotuwethfrsa";
+
+
+// Image of the schedule in flash
+struct Stored {
+    uint32_t magic;
+    uint8_t count;
+    FeedSchedule::Entry entries[FeedSchedule::max_entries];
+    uint32_t checksum;
+};
+
+static constexpr uint32_t stored_magic = 0x46534331;  // "FSC1"
+
+
+static uint32_t checksum(const Stored& stored)
+{
+    // FNV-1a over everything before the checksum
+    uint32_t hash = 2166136261u;
+    auto data = (const uint8_t*) &stored;
+    for (size_t i = 0; i != offsetof(Stored, checksum); ++i)
+        hash = (hash ^ data[i]) * 16777619u;
+    return hash;
+}
+
+
+void FeedSchedule::begin()
+{
+    load();
+    configTime(TIME_ZONE, NTP_SERVER);
+    // Parse TZ now, not in the first `due()` in loop
+    time_t now = time(nullptr);
+    struct tm local;
+    localtime_r(&now, &local);
+}
+
+
+void FeedSchedule::load()
+{
+    Stored stored;
+    EEPROM.begin(sizeof(Stored));
+    EEPROM.get(0, stored);
+    EEPROM.end();
+    if (stored.magic != stored_magic || stored.count > max_entries
+            || stored.checksum != checksum(stored)) {
+        LOG_INFO("[schedule] Nothing stored\n");
+        return;
+    }
+    m_count = stored.count;
+    memcpy(m_entries, stored.entries, sizeof(m_entries));
+    LOG_INFO("[schedule] Loaded %d entries\n", m_count);
+}
+
+
+void FeedSchedule::save()
+{
+    Stored stored;
+    memset(&stored, 0, sizeof(stored));
+    stored.magic = stored_magic;
+    stored.count = m_count;
+    memcpy(stored.entries, m_entries, sizeof(m_entries));
+    stored.checksum = checksum(stored);
+
+    // The flash sector is copied to heap and written back
+    heap_check::Pause pause;
+    EEPROM.begin(sizeof(Stored));
+    EEPROM.put(0, stored);
+    bool ok = EEPROM.commit();
+    EEPROM.end();
+    if (ok)
+        LOG_INFO("[schedule] Stored %d entries\n", m_count);
+    else
+        LOG_ERROR("[schedule] Flash write failed\n");
+}
+
+
+bool FeedSchedule::parse(const char* args, Entry& entry)
+{
+    // HH:MM[:SS]
+    char* end;
+    long hour = strtol(args, &end, 10);
+    if (end == args || *end != ':')
+        return false;
+    long minute = strtol(end + 1, &end, 10);
+    long second = 0;
+    if (*end == ':')
+        second = strtol(end + 1, &end, 10);
+    if (hour < 0 || hour > 23 || minute < 0 || minute > 59 || second < 0 || second > 59)
+        return false;
+    entry = {uint32_t(hour * 3600 + minute * 60 + second), 0, 0x7f, 1};
+
+    // key=value options
+    for (const char* p = end; *p != '\0'; ) {
+        if (*p == ' ') {
+            ++p;
+            continue;
+        }
+        if (strncmp_P(p, PSTR("days="), 5) == 0) {
+            p += 5;
+            entry.days = 0;
+            while (*p != '\0' && *p != ' ') {
+                uint8_t day = 0;
+                while (day != 7 && (pgm_read_byte(day_names + 2 * day) != p[0]
+                                 || pgm_read_byte(day_names + 2 * day + 1) != p[1]))
+                    ++day;
+                if (day == 7)
+                    return false;
+                entry.days |= 1 << day;
+                p += 2;
+                if (*p == ',')
+                    ++p;
+            }
+            if (entry.days == 0)
+                return false;
+        } else if (strncmp_P(p, PSTR("every="), 6) == 0) {
+            long every = strtol(p + 6, &end, 10);
+            if (every < 1 || every > 1440)
+                return false;
+            entry.every = uint16_t(every);
+            p = end;
+        } else if (strncmp_P(p, PSTR("count="), 6) == 0) {
+            long count = strtol(p + 6, &end, 10);
+            if (count < 1 || count > 100)
+                return false;
+            entry.count = uint8_t(count);
+            p = end;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool FeedSchedule::command(const char* args)
+{
+    // The first schedule line of a batch starts a new schedule
+    if (!m_updating) {
+        m_updating = true;
+        m_invalid = false;
+        m_new_count = 0;
+    }
+    if (strcmp_P(args, PSTR("clear")) == 0)
+        return true;
+    Entry entry;
+    if (!parse(args, entry)) {
+        m_invalid = true;
+        return false;
+    }
+    if (m_new_count == max_entries) {
+        LOG_WARN("[schedule] Full, max %d entries\n", max_entries);
+        m_invalid = true;
+        return false;
+    }
+    m_new[m_new_count++] = entry;
+    return true;
+}
+
+
+void FeedSchedule::commit()
+{
+    if (!m_updating)
+        return;
+    m_updating = false;
+    if (m_invalid) {
+        LOG_WARN("[schedule] Not changed, the new one has errors\n");
+        return;
+    }
+    m_count = m_new_count;
+    memcpy(m_entries, m_new, sizeof(m_entries));
+    save();
+}
+
+
+int FeedSchedule::due()
+{
+    time_t now = time(nullptr);
+    if (now < valid_time || now == m_last)
+        return 0;
+    time_t from = (now < m_last || now - m_last > max_catch_up) ? now : m_last + 1;
+    m_last = now;
+
+    int count = 0;
+    for (time_t t = from; t <= now; ++t) {
+        struct tm local;
+        localtime_r(&t, &local);
+        uint32_t sec = local.tm_hour * 3600 + local.tm_min * 60 + local.tm_sec;
+        for (uint8_t i = 0; i != m_count; ++i) {
+            const Entry& entry = m_entries[i];
+            if (!(entry.days & (1 << local.tm_wday)) || sec < entry.start)
+                continue;
+            if (entry.every == 0 ? sec != entry.start : (sec - entry.start) % (entry.every * 60u) != 0)
+                continue;
+            LOG_INFO("[schedule] %02d:%02d:%02d feed (%d)\n",
+                     local.tm_hour, local.tm_min, local.tm_sec, entry.count);
+            count += entry.count;
+        }
+    }
+    return count;
+}
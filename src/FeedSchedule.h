@@ -0,0 +1,68 @@
+// FeedSchedule.h - created by Radek Brich on 2026-10-19
+
+#ifndef GADGETS_FEEDSCHEDULE_H
+#define GADGETS_FEEDSCHEDULE_H
+
+#include <Arduino.h>
+#include <time.h>
+
+// SNTP server and POSIX time zone of the schedule (override in config.h)
+#ifndef NTP_SERVER
+#define NTP_SERVER "pool.ntp.org"
+#endif
+#ifndef TIME_ZONE
+#define TIME_ZONE "CET-1CEST,M3.5.0,M10.5.0/3"
+#endif
+
+// Feeding times, run locally against SNTP time - on time to the second,
+// also while the server is unreachable. Kept in flash (EEPROM emulation),
+// so the schedule survives reboot without the server.
+//
+// Set by control commands. The schedule lines of one command batch
+// (one X-Seq) replace the stored schedule - only if all of them are valid:
+//
+//   schedule <HH:MM[:SS]> [days=<su,mo,tu,we,th,fr,sa>] [every=<minutes>] [count=<N>]
+//   schedule clear
+//
+// e.g. "schedule 7:30 count=2", "schedule 6:00 every=360", "schedule 18:00 days=sa,su".
+// `every` repeats the feeding from the start time until midnight.
+class FeedSchedule {
+public:
+    static constexpr uint8_t max_entries = 8;
+
+    struct Entry {
+        uint32_t start;     // seconds since midnight, local time
+        uint16_t every;     // repeat period in minutes, 0 = once a day
+        uint8_t days;       // bit mask, bit 0 = Sunday
+        uint8_t count;      // sweeps
+    };
+
+    // Load the schedule from flash, start SNTP
+    void begin();
+
+    // Arguments of control command "schedule ...", false on syntax error
+    bool command(const char* args);
+
+    // End of command batch: store the new schedule, if the batch has
+    // a valid one (otherwise keep the current)
+    void commit();
+
+    // Sweeps due since the last call (0 = none), call this on every loop pass.
+    // Nothing is due until SNTP sets the clock.
+    int due();
+
+private:
+    static bool parse(const char* args, Entry& entry);
+    void load();
+    void save();
+
+    Entry m_entries[max_entries];
+    uint8_t m_count = 0;
+    Entry m_new[max_entries];   // of current batch, until `commit()`
+    uint8_t m_new_count = 0;
+    bool m_updating = false;    // a schedule command came in current batch
+    bool m_invalid = false;     // ... and one of them was bad
+    time_t m_last = 0;          // last second checked by `due()`
+};
+
+#endif // include guard
@@ -0,0 +1,202 @@
+// Gorilla.cpp - created by Radek Brich on 2026-10-19
+
+#include "Gorilla.h"
+#include <string.h>
+
+namespace gorilla {
+
+
+void Encoder::reset()
+{
+    m_bit_pos = header_size * 8;
+    m_overflow = false;
+    m_count = 0;
+    m_time = 0;
+    m_delta = 0;
+    m_value = 0;
+    m_leading = 0xff;
+    m_trailing = 0;
+    if (m_size < header_size) {
+        // nothing fits
+        m_size = 0;
+        return;
+    }
+    m_buffer[0] = version;
+    m_buffer[1] = 0;
+    m_buffer[2] = 0;
+}
+
+
+void Encoder::write_bits(uint32_t value, uint8_t bits)
+{
+    while (bits != 0) {
+        size_t byte = m_bit_pos / 8;
+        if (byte >= m_size) {
+            m_overflow = true;
+            return;
+        }
+        // Set the bits explicitly, a rolled back sample left garbage here
+        uint8_t room = 8 - m_bit_pos % 8;
+        uint8_t n = bits < room ? bits : room;
+        uint8_t shift = room - n;
+        uint8_t mask = uint8_t(((1u << n) - 1) << shift);
+        uint8_t chunk = uint8_t((value >> (bits - n)) << shift);
+        m_buffer[byte] = uint8_t((m_buffer[byte] & ~mask) | (chunk & mask));
+        m_bit_pos += n;
+        bits -= n;
+    }
+}
+
+
+bool Encoder::append(uint32_t time, float value)
+{
+    if (m_count == UINT16_MAX)
+        return false;
+    uint32_t raw;
+    memcpy(&raw, &value, sizeof(raw));
+
+    // Restored when the sample doesn't fit
+    size_t bit_pos = m_bit_pos;
+    uint8_t leading = m_leading;
+    uint8_t trailing = m_trailing;
+
+    uint32_t delta = 0;
+    if (m_count == 0) {
+        write_bits(time, 32);
+        write_bits(raw, 32);
+    } else {
+        // Unsigned arithmetic wraps the same way in the decoder
+        delta = time - m_time;
+        auto dod = int32_t(delta - uint32_t(m_delta));
+        if (dod == 0) {
+            write_bits(0, 1);
+        } else if (dod >= -63 && dod <= 64) {
+            write_bits(0x2, 2);
+            write_bits(uint32_t(dod + 63), 7);
+        } else if (dod >= -255 && dod <= 256) {
+            write_bits(0x6, 3);
+            write_bits(uint32_t(dod + 255), 9);
+        } else if (dod >= -2047 && dod <= 2048) {
+            write_bits(0xe, 4);
+            write_bits(uint32_t(dod + 2047), 12);
+        } else {
+            write_bits(0xf, 4);
+            write_bits(uint32_t(dod), 32);
+        }
+
+        uint32_t x = raw ^ m_value;
+        if (x == 0) {
+            write_bits(0, 1);
+        } else {
+            auto lead = uint8_t(__builtin_clz(x));
+            auto trail = uint8_t(__builtin_ctz(x));
+            if (m_leading != 0xff && lead >= m_leading && trail >= m_trailing) {
+                // fits in the previous window
+                write_bits(0x2, 2);
+                write_bits(x >> m_trailing, 32 - m_leading - m_trailing);
+            } else {
+                uint8_t length = 32 - lead - trail;
+                write_bits(0x3, 2);
+                write_bits(lead, 5);
+                write_bits(length - 1, 5);
+                write_bits(x >> trail, length);
+                m_leading = lead;
+                m_trailing = trail;
+            }
+        }
+    }
+
+    if (m_overflow) {
+        m_overflow = false;
+        m_bit_pos = bit_pos;
+        m_leading = leading;
+        m_trailing = trailing;
+        return false;
+    }
+    m_delta = int32_t(delta);
+    m_time = time;
+    m_value = raw;
+    ++m_count;
+    m_buffer[1] = uint8_t(m_count);
+    m_buffer[2] = uint8_t(m_count >> 8);
+    return true;
+}
+
+
+Decoder::Decoder(const uint8_t* data, size_t size)
+    : m_data(data), m_size(size)
+{
+    if (size >= header_size && data[0] == version)
+        m_count = uint16_t(data[1] | data[2] << 8);
+}
+
+
+uint32_t Decoder::read_bits(uint8_t bits)
+{
+    uint32_t value = 0;
+    while (bits != 0) {
+        size_t byte = m_bit_pos / 8;
+        if (byte >= m_size) {
+            m_overflow = true;
+            return 0;
+        }
+        uint8_t room = 8 - m_bit_pos % 8;
+        uint8_t n = bits < room ? bits : room;
+        uint8_t chunk = uint8_t(m_data[byte] >> (room - n)) & uint8_t((1u << n) - 1);
+        value = value << n | chunk;
+        m_bit_pos += n;
+        bits -= n;
+    }
+    return value;
+}
+
+
+bool Decoder::next(uint32_t& time, float& value)
+{
+    if (m_read == m_count)
+        return false;
+    if (m_read == 0) {
+        m_time = read_bits(32);
+        m_value = read_bits(32);
+    } else {
+        uint32_t dod;
+        if (read_bits(1) == 0)
+            dod = 0;
+        else if (read_bits(1) == 0)
+            dod = read_bits(7) - 63;
+        else if (read_bits(1) == 0)
+            dod = read_bits(9) - 255;
+        else if (read_bits(1) == 0)
+            dod = read_bits(12) - 2047;
+        else
+            dod = read_bits(32);
+        m_delta = int32_t(uint32_t(m_delta) + dod);
+        m_time += uint32_t(m_delta);
+
+        if (read_bits(1) == 1) {
+            if (read_bits(1) == 1) {
+                m_leading = uint8_t(read_bits(5));
+                uint8_t length = uint8_t(read_bits(5) + 1);
+                if (m_leading + length > 32) {
+                    // corrupted block
+                    m_read = m_count;
+                    return false;
+                }
+                m_trailing = uint8_t(32 - m_leading - length);
+            }
+            uint8_t length = 32 - m_leading - m_trailing;
+            m_value ^= read_bits(length) << m_trailing;
+        }
+    }
+    if (m_overflow) {
+        // truncated or corrupted block
+        m_read = m_count;
+        return false;
+    }
+    ++m_read;
+    time = m_time;
+    memcpy(&value, &m_value, sizeof(value));
+    return true;
+}
+
+} // namespace gorilla
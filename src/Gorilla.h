@@ -0,0 +1,95 @@
+// Gorilla.h - created by Radek Brich on 2026-10-19
+
+#ifndef GADGETS_GORILLA_H
+#define GADGETS_GORILLA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Compressed block of samples of one series (time, float value),
+// as in Facebook's Gorilla TSDB: delta-of-delta timestamps, XOR values.
+//
+// Block format:
+//   <version:1> <count:2 LE> <bit stream, MSB first>
+// First sample: time (32 bits), value (32 bits, IEEE 754 float).
+// Next samples:
+//   time - delta of delta D (delta of the first one is against 0):
+//     '0'                  D = 0
+//     '10'   + 7 bits      D in [-63, 64]      (stored D + 63)
+//     '110'  + 9 bits      D in [-255, 256]    (stored D + 255)
+//     '1110' + 12 bits     D in [-2047, 2048]  (stored D + 2047)
+//     '1111' + 32 bits     any
+//   value - X = value XOR previous value:
+//     '0'                  X = 0
+//     '10' + bits          meaningful bits of X in the previous window
+//     '11' + <leading zeros:5> <length - 1:5> + bits   new window
+//
+// The decoder is in server/gorilla.py, benchmark in bench/gorilla_bench.cpp.
+namespace gorilla {
+
+constexpr uint8_t version = 1;
+constexpr size_t header_size = 3;
+
+// Appends samples to a block in a caller's buffer
+class Encoder {
+public:
+    Encoder(uint8_t* buffer, size_t size) : m_buffer(buffer), m_size(size) { reset(); }
+
+    // Start a new (empty) block
+    void reset();
+
+    // Returns false when the sample doesn't fit, the block stays valid
+    // - time is in seconds (or any unit), it should not decrease
+    bool append(uint32_t time, float value);
+
+    const uint8_t* data() const { return m_buffer; }
+    size_t size() const { return (m_bit_pos + 7) / 8; }
+    uint16_t count() const { return m_count; }
+
+private:
+    void write_bits(uint32_t value, uint8_t bits);
+
+    uint8_t* m_buffer;
+    size_t m_size;
+    size_t m_bit_pos = 0;
+    bool m_overflow = false;
+
+    uint16_t m_count = 0;
+    uint32_t m_time = 0;
+    int32_t m_delta = 0;
+    uint32_t m_value = 0;       // previous value, raw bits
+    uint8_t m_leading = 0xff;   // window of previous XOR, 0xff = none
+    uint8_t m_trailing = 0;
+};
+
+// Reads samples from a block
+class Decoder {
+public:
+    Decoder(const uint8_t* data, size_t size);
+
+    // Number of samples in the block, 0 for invalid block
+    uint16_t count() const { return m_count; }
+
+    // Next sample, false at the end of the block (or when it's truncated)
+    bool next(uint32_t& time, float& value);
+
+private:
+    uint32_t read_bits(uint8_t bits);
+
+    const uint8_t* m_data;
+    size_t m_size;
+    size_t m_bit_pos = header_size * 8;
+    bool m_overflow = false;
+
+    uint16_t m_count = 0;
+    uint16_t m_read = 0;
+    uint32_t m_time = 0;
+    int32_t m_delta = 0;
+    uint32_t m_value = 0;
+    uint8_t m_leading = 0;
+    uint8_t m_trailing = 0;
+};
+
+} // namespace gorilla
+
+#endif // include guard
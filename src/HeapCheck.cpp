@@ -0,0 +1,91 @@
+// HeapCheck.cpp - created by Radek Brich on 2026-10-19
+
+#include "HeapCheck.h"
+
+#ifdef CHECK_HEAP
+
+#include <Arduino.h>
+#include <stdlib.h>
+
+// Per-device state, see sensors.cpp
+#ifndef DEVICE_STATE
+#define DEVICE_STATE static
+#endif
+
+namespace heap_check {
+
+DEVICE_STATE bool armed = false;
+DEVICE_STATE int paused = 0;
+DEVICE_STATE unsigned long count = 0;
+DEVICE_STATE size_t last_size = 0;
+DEVICE_STATE void* last_caller = nullptr;
+
+void arm() { armed = true; }
+void disarm() { armed = false; }
+
+Pause::Pause() { ++paused; }
+Pause::~Pause() { --paused; }
+
+
+void on_alloc(size_t size, void* caller)
+{
+    if (!armed || paused != 0)
+        return;
+    ++count;
+    last_size = size;
+    last_caller = caller;
+}
+
+
+bool report(Print& out)
+{
+    if (count == 0)
+        return true;
+    out.printf_P(PSTR("HEAP CHECK: %lu allocation(s), last %u B from %p\n"),
+               count, (unsigned) last_size, last_caller);
+    count = 0;
+    return false;
+}
+
+
+void verify(Print& out)
+{
+    if (!report(out)) {
+        out.flush();
+        abort();
+    }
+}
+
+} // namespace heap_check
+
+
+#ifndef SIM_HOST
+// Linker wraps (-Wl,--wrap=malloc etc.)
+extern "C" {
+
+void* __real_malloc(size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void* __real_calloc(size_t nmemb, size_t size);
+
+void* __wrap_malloc(size_t size)
+{
+    heap_check::on_alloc(size, __builtin_return_address(0));
+    return __real_malloc(size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size)
+{
+    heap_check::on_alloc(size, __builtin_return_address(0));
+    return __real_realloc(ptr, size);
+}
+
+void* __wrap_calloc(size_t nmemb, size_t size)
+{
+    heap_check::on_alloc(nmemb * size, __builtin_return_address(0));
+    return __real_calloc(nmemb, size);
+}
+
+} // extern "C"
+#endif
+
+#endif // CHECK_HEAP
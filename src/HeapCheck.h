@@ -0,0 +1,55 @@
+// HeapCheck.h - created by Radek Brich on 2026-10-19
+
+#ifndef GADGETS_HEAPCHECK_H
+#define GADGETS_HEAPCHECK_H
+
+#include <Print.h>
+#include <stddef.h>
+
+// Heap allocation counter, proves the steady state of loop() is heap-free.
+//
+// Enabled by build flags:
+//   -DCHECK_HEAP -Wl,--wrap=malloc -Wl,--wrap=realloc -Wl,--wrap=calloc
+// (the fleet simulator needs only -DCHECK_HEAP, see sim/Heap.cpp)
+//
+// Allocations are counted between `arm()` and `disarm()`, except in `Pause`
+// scopes. These wrap calls into the network stack and system tasks (yield, delay),
+// which allocate packet buffers from the heap on their own.
+namespace heap_check {
+
+#ifdef CHECK_HEAP
+
+void arm();
+void disarm();
+
+// Called from malloc wrappers
+void on_alloc(size_t size, void* caller);
+
+// Print counted allocations, returns true if there were none
+bool report(Print& out);
+
+// Abort (with stack dump on device) if there were any allocations
+void verify(Print& out);
+
+class Pause {
+public:
+    Pause();
+    ~Pause();
+};
+
+#else
+
+inline void arm() {}
+inline void disarm() {}
+inline bool report(Print&) { return true; }
+inline void verify(Print&) {}
+class Pause {
+public:
+    ~Pause() {}  // non-trivial, no "unused variable" warnings
+};
+
+#endif
+
+} // namespace heap_check
+
+#endif // include guard
@@ -1,12 +1,34 @@
 // HttpClient.cpp - created by Radek Brich on 2019-09-13
 
+#include "config.h"
 #include "HttpClient.h"
+#include "HeapCheck.h"
+#include "Log.h"
+#include "Trace.h"
 
+#ifdef WITH_METRICS
+#include "MetricsServer.h"
+#endif
 
-bool HttpClient::connect(const String& host, uint16_t port)
+
+// Strip whitespace from both ends, in place
+static char* trim(char* str)
+{
+    while (isspace(*str))
+        ++str;
+    char* end = str + strlen(str);
+    while (end != str && isspace(end[-1]))
+        --end;
+    *end = '\0';
+    return str;
+}
+
+
+bool HttpClient::connect(const char* host, uint16_t port, unsigned long timeout)
 {
     m_host = host;
     m_port = port;
+    m_timeout = timeout;
     return _connect();
 }
 
@@ -19,119 +41,194 @@ bool HttpClient::reconnect()
 
 bool HttpClient::_connect()
 {
-    Serial.println("* Connecting to " + m_host + ":" + String(m_port) + " ...");
-    m_display.drawText(2, "Send ");
+    LOG_INFO("* Connecting to %s:%u ...\n", m_host, m_port);
+    m_display.drawText(2, F("Send "));
     m_display.display();
-    if (m_client.connect(m_host, m_port)) {
-        Serial.printf("* Connected (%s)\n", m_client.remoteIP().toString().c_str());
+    bool connected;
+    auto start = millis();
+    {
+        heap_check::Pause pause;
+        m_client.setTimeout(m_timeout);
+        connected = m_client.connect(m_host, m_port);
+    }
+    trace::connect(connected, millis() - start);
+    if (connected) {
+        auto ip = m_client.remoteIP();
+        LOG_DEBUG("* Connected (%u.%u.%u.%u)\n", ip[0], ip[1], ip[2], ip[3]);
         return true;
     } else {
-        Serial.println("* Connection failed.");
+        LOG_WARN("* Connection failed.\n");
         return false;
     }
 }
 
 
-int HttpClient:: query(const char *method, const char* url,
-        const XHdrCallback& x_hdr_cb, const ContentCallback& cnt_cb)
+bool HttpClient::send_request(const char* method, const char* url,
+                              const char* content_type, size_t content_length)
 {
-    Serial.printf("* %s %s\n", method, url);
-    m_client.printf(
+    LOG_INFO("* %s %s\n", method, url);
+
+    int len = snprintf_P(m_line, sizeof(m_line), PSTR(
             "%s %s HTTP/1.1\r\n"
             "Host: %s:%d\r\n"
-            "Connection: close\r\n"
-            "\r\n",
-            method, url, m_host.c_str(), m_port);
-    Serial.println("* Waiting for response...");
+            "Connection: close\r\n"),
+            method, url, m_host, m_port);
+    if (content_type != nullptr && len > 0 && size_t(len) < sizeof(m_line)) {
+        len += snprintf_P(m_line + len, sizeof(m_line) - len, PSTR(
+                "Content-Type: %s\r\n"
+                "Content-Length: %u\r\n"),
+                content_type, (unsigned) content_length);
+    }
+    if (m_if_none_match != nullptr && len > 0 && size_t(len) < sizeof(m_line)) {
+        len += snprintf_P(m_line + len, sizeof(m_line) - len, PSTR(
+                "If-None-Match: %s\r\n"), m_if_none_match);
+        m_if_none_match = nullptr;
+    }
+    if (len < 0 || size_t(len) + 2 >= sizeof(m_line)) {
+        LOG_ERROR("* Request too long.\n");
+        return false;
+    }
+    memcpy(m_line + len, "\r\n", 2);
 
-    int content_length = 0;
-    bool awaiting_headers = true;
-    int status = -1;
-    while (m_client.connected() || m_client.available()) {
+    trace::send((const uint8_t*) m_line, len + 2);
+    heap_check::Pause pause;
+    return m_client.write((const uint8_t*) m_line, len + 2) == size_t(len + 2);
+}
+
+
+int HttpClient::read_line()
+{
+    size_t len = 0;
+    int consumed = 0;
+    auto last = millis();
+    for (;;) {
         if (m_client.available()) {
-            String line = m_client.readStringUntil('\n');
-
-            if (awaiting_headers) {
-                line.trim();
-                if (line.length() == 0) {
-                    Serial.println("* End of headers");
-                    awaiting_headers = false;
-                } else
-
-                // Process headers
-                if (line.startsWith("HTTP/")) {
-                    // HTTP/1.0 404 Not Found
-                    auto space = line.indexOf(' ');
-                    status = (int) line.substring(space, space + 4).toInt();
-                } else
-
-                if (line.startsWith("Content-Length: ")) {
-                    content_length = (int) line.substring(strlen("Content-Length: ")).toInt();
-                } else
-
-                if (line.startsWith("X-")) {
-                    auto colon = line.indexOf(':');
-                    auto name = line.substring(0, colon);
-                    auto value = line.substring(colon + 1);
-                    name.trim();
-                    value.trim();
-                    x_hdr_cb(name, value);
-                    continue;
-                } else {
-                    // Unknown header
-                    //Serial.print("Ignored header: ");
-                    //Serial.println(line);
-                }
-            } else {
-                // Process body
-                content_length -= int(line.length() + 1);
-                line.trim();
-                cnt_cb(line);
-                if (content_length <= 0)
-                    break;
-            }
+            int c = m_client.read();
+            trace::receive(uint8_t(c));
+            ++consumed;
+            last = millis();
+            if (c == '\n')
+                break;
+            // Truncate long lines
+            if (len < sizeof(m_line) - 1)
+                m_line[len++] = (char) c;
+        } else if (!m_client.connected()) {
+            trace::closed();
+            // Last line may be without newline, don't wait for it
+            if (consumed == 0)
+                return -1;
+            break;
+        } else if (millis() - last >= HTTP_RESPONSE_TIMEOUT) {
+            // Connected, but the server doesn't respond
+            LOG_WARN("* Response timeout\n");
+            stop();
+            return -2;
+        } else {
+            logger.loop();
+            m_display.loop();
+#ifdef WITH_METRICS
+            metrics.loop();
+#endif
+            heap_check::Pause pause;
+            yield();
         }
-
-        yield();
     }
+    m_line[len] = '\0';
+    return consumed;
+}
 
-    return status;
+
+int HttpClient:: query(const char *method, const char* url,
+        const XHdrCallback& x_hdr_cb, const ContentCallback& cnt_cb)
+{
+    if (!send_request(method, url, nullptr, 0))
+        return -1;
+    return read_response(x_hdr_cb, cnt_cb);
 }
 
 
-void HttpClient:: post(const char* url, const String& data)
+int HttpClient:: post(const char* url, const char* data, size_t length,
+        const XHdrCallback& x_hdr_cb, const ContentCallback& cnt_cb)
 {
-    Serial.printf("* POST %s\n", url);
-    m_client.printf(
-            "POST %s HTTP/1.1\r\n"
-            "Host: %s:%d\r\n"
-            "Connection: close\r\n"
-            "Content-Type: text/plain; charset=utf-8\r\n"
-            "Content-Length: %d\r\n"
-            "\r\n",
-            url, m_host.c_str(), m_port, data.length());
-    m_client.print(data);
-
-    m_display.appendText("OK");
-    m_display.drawText(3, "Recv ");
+    if (!send_request("POST", url, "text/plain; charset=utf-8", length))
+        return -1;
+    trace::send((const uint8_t*) data, length);
+    {
+        heap_check::Pause pause;
+        m_client.write((const uint8_t*) data, length);
+    }
+
+    m_display.appendText(F("OK"));
+    m_display.drawText(3, F("Recv "));
     m_display.display();
 
-    Serial.println("* Waiting for response...");
+    return read_response(x_hdr_cb, cnt_cb);
+}
+
 
-    while (m_client.connected() || m_client.available()) {
-        if (m_client.available()) {
-            String line = m_client.readStringUntil('\n');
-            Serial.println(line);
-        }
+int HttpClient::read_response(const XHdrCallback& x_hdr_cb, const ContentCallback& cnt_cb)
+{
+    LOG_DEBUG("* Waiting for response...\n");
 
-        yield();
+    int content_length = 0;
+    bool awaiting_headers = true;
+    int status = -1;
+    int consumed;
+    while ((consumed = read_line()) >= 0) {
+        char* line = trim(m_line);
+        if (awaiting_headers) {
+            if (*line == '\0') {
+                LOG_DEBUG("* End of headers\n");
+                // Not Modified has no body, don't wait for the server to close
+                if (status == 304)
+                    break;
+                awaiting_headers = false;
+            } else
+
+            // Process headers
+            if (strncmp_P(line, PSTR("HTTP/"), 5) == 0) {
+                // HTTP/1.0 404 Not Found
+                auto space = strchr(line, ' ');
+                if (space != nullptr)
+                    status = atoi(space);
+            } else
+
+            if (strncmp_P(line, PSTR("Content-Length: "), 16) == 0) {
+                content_length = atoi(line + 16);
+            } else
+
+            if (strncmp_P(line, PSTR("X-"), 2) == 0) {
+                auto colon = strchr(line, ':');
+                if (colon == nullptr)
+                    continue;
+                *colon = '\0';
+                x_hdr_cb(trim(line), trim(colon + 1));
+                continue;
+            } else {
+                // Unknown header
+                //LOG_DEBUG("Ignored header: %s\n", line);
+            }
+        } else {
+            // Process body
+            content_length -= consumed;
+            cnt_cb(line);
+            if (content_length <= 0)
+                break;
+        }
     }
+
+    // Incomplete response
+    if (consumed == -2)
+        return -1;
+    return status;
 }
 
 
 void HttpClient::stop()
 {
-    m_client.stop();
-    Serial.println("* Connection closed");
+    {
+        heap_check::Pause pause;
+        m_client.stop();
+    }
+    LOG_DEBUG("* Connection closed\n");
 }
-
@@ -7,29 +7,63 @@
 #include <ESP8266WiFi.h>
 #include <functional>
 
+// Longest wait for the response data, ms. The server forwards a report to
+// InfluxDB before it responds (with its own timeout of 10 s).
+#ifndef HTTP_RESPONSE_TIMEOUT
+#define HTTP_RESPONSE_TIMEOUT 15000
+#endif
+
+// Minimal HTTP/1.1 client, doesn't allocate on heap.
+// Headers and lines are processed in fixed buffer.
 class HttpClient {
 public:
     explicit HttpClient(Display& display) : m_display(display) {}
 
-    bool connect(const String& host, uint16_t port);
+    // `host` must outlive the client (a literal),
+    // `timeout` is for the TCP connect, in ms (the response has HTTP_RESPONSE_TIMEOUT)
+    bool connect(const char* host, uint16_t port, unsigned long timeout = 5000);
     bool reconnect();
 
-    using XHdrCallback = std::function<void(const String& name, const String& value)>;
-    using ContentCallback = std::function<void(const String& line)>;
+    // Callback arguments point into the line buffer, valid only in the call.
+    // Keep lambda captures small (one reference) - std::function
+    // would allocate for bigger ones.
+    using XHdrCallback = std::function<void(const char* name, const char* value)>;
+    using ContentCallback = std::function<void(const char* line)>;
+    // Both return HTTP status of the response, -1 on error
     int query(const char *method, const char* url,
               const XHdrCallback& x_hdr_cb, const ContentCallback& cnt_cb);
-    void post(const char* url, const String& data);
+    int post(const char* url, const char* data, size_t length,
+             const XHdrCallback& x_hdr_cb, const ContentCallback& cnt_cb);
+
+    // Conditional request: the next query gets 304 (without body) while
+    // the resource has this ETag, e.g. "\"12\"". Must outlive the query.
+    void if_none_match(const char* etag) { m_if_none_match = etag; }
 
     void stop();
 
 private:
     bool _connect();
 
+    // Send request line and headers, formatted in the line buffer
+    bool send_request(const char* method, const char* url,
+                      const char* content_type, size_t content_length);
+
+    // Read status, X- headers and content lines
+    int read_response(const XHdrCallback& x_hdr_cb, const ContentCallback& cnt_cb);
+
+    // Read one line into the line buffer, trimmed.
+    // Returns number of bytes consumed (including "\r\n"),
+    // -1 when the connection is closed, -2 on timeout (no data for HTTP_RESPONSE_TIMEOUT).
+    int read_line();
+
 private:
     WiFiClient m_client;
     Display& m_display;
-    String m_host;
+    const char* m_host = "";
     uint16_t m_port = 0;
+    unsigned long m_timeout = 5000;
+    const char* m_if_none_match = nullptr;
+    char m_line[256];
 };
 
 #endif // include guard
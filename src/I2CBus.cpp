@@ -0,0 +1,99 @@
+// I2CBus.cpp - created by Radek Brich on 2026-10-19
+
+#include "I2CBus.h"
+
+#ifdef WITH_I2C
+
+I2CBus i2c_bus;
+I2CBus::Device* I2CBus::Device::m_first = nullptr;
+
+
+I2CBus::Device::Device(const char* name, uint8_t address, uint32_t max_clock) noexcept
+    : m_name(name), m_address(address), m_max_clock(max_clock)
+{
+    m_next = m_first;
+    m_first = this;
+}
+
+
+uint32_t I2CBus::Device::clock() const
+{
+    return min(m_max_clock, uint32_t(I2C_BUS_CLOCK));
+}
+
+
+void I2CBus::begin()
+{
+    Wire.begin();
+    m_clock = 0;
+    m_report_time = micros();
+}
+
+
+uint32_t I2CBus::select(Device& dev)
+{
+    if (dev.clock() != m_clock) {
+        m_clock = dev.clock();
+        Wire.setClock(m_clock);
+    }
+    return micros();
+}
+
+
+void I2CBus::done(Device& dev, uint32_t start, bool ok)
+{
+    dev.m_busy_us += micros() - start;
+    ++dev.m_transactions;
+    if (!ok)
+        ++dev.m_errors;
+}
+
+
+bool I2CBus::write(Device& dev, uint8_t prefix, const uint8_t* data, size_t length)
+{
+    uint32_t start = select(dev);
+    Wire.beginTransmission(dev.m_address);
+    Wire.write(prefix);
+    bool ok = Wire.write(data, length) == length;
+    ok = (Wire.endTransmission() == 0) && ok;
+    done(dev, start, ok);
+    return ok;
+}
+
+
+bool I2CBus::read(Device& dev, uint8_t* data, size_t length)
+{
+    uint32_t start = select(dev);
+    bool ok = Wire.requestFrom(dev.m_address, uint8_t(length)) == length;
+    for (size_t i = 0; ok && i != length; ++i)
+        data[i] = (uint8_t) Wire.read();
+    done(dev, start, ok);
+    return ok;
+}
+
+
+void I2CBus::report(Print& out)
+{
+    uint32_t now = micros();
+    uint32_t elapsed = now - m_report_time;
+    m_report_time = now;
+
+    uint32_t busy = 0;
+    for (Device* dev = Device::m_first; dev != nullptr; dev = dev->m_next)
+        busy += dev->m_busy_us;
+    // in 0.01 %
+    auto utilisation = (unsigned long) (uint64_t(busy) * 10000 / max(elapsed, uint32_t(1)));
+    out.printf_P(PSTR("[I2C] busy %lu.%02lu %%\n"), utilisation / 100, utilisation % 100);
+
+    for (Device* dev = Device::m_first; dev != nullptr; dev = dev->m_next) {
+        out.printf_P(PSTR("[I2C] %s (0x%02x, %lu kHz): %lu transactions, %lu errors, %lu.%03lu ms\n"),
+                   dev->m_name, dev->m_address, (unsigned long) (dev->clock() / 1000),
+                   (unsigned long) dev->m_transactions, (unsigned long) dev->m_errors,
+                   (unsigned long) (dev->m_busy_us / 1000), (unsigned long) (dev->m_busy_us % 1000));
+        dev->m_transactions = 0;
+        dev->m_errors = 0;
+        dev->m_busy_us = 0;
+    }
+}
+
+#endif // WITH_I2C
@@ -0,0 +1,92 @@
+// I2CBus.h - created by Radek Brich on 2026-10-19
+
+#ifndef GADGETS_I2CBUS_H
+#define GADGETS_I2CBUS_H
+
+#if defined(WITH_OLED) || defined(WITH_SHT30) || defined(WITH_BMP280)
+#define WITH_I2C
+#endif
+
+#ifdef WITH_I2C
+
+#include <Arduino.h>
+#include <Print.h>
+#include <Wire.h>
+
+// Fastest clock of the bus master, Hz. The ESP8266 I2C is bit-banged,
+// 400 kHz is safe at 80 MHz CPU, Fast-mode plus needs 160 MHz.
+#ifndef I2C_BUS_CLOCK
+#define I2C_BUS_CLOCK 400000
+#endif
+
+// All devices on the `Wire` bus go through this, one transaction at a time.
+//
+// Each device runs at its own clock - the lower of its maximum and
+// I2C_BUS_CLOCK, `Wire.setClock()` is called only when it changes.
+// Transactions are timed and counted per device, `report()` prints
+// bus utilisation and errors.
+//
+// Long transfers (display frame) are split by their owner into short
+// transactions, spread over loop passes, see Display::loop().
+class I2CBus {
+public:
+    class Device {
+    public:
+        // max_clock: from the datasheet, Hz
+        Device(const char* name, uint8_t address, uint32_t max_clock) noexcept;
+
+        const char* name() const { return m_name; }
+        uint8_t address() const { return m_address; }
+        uint32_t clock() const;
+
+    private:
+        friend class I2CBus;
+        const char* m_name;
+        uint8_t m_address;
+        uint32_t m_max_clock;
+
+        // since last report
+        uint32_t m_transactions = 0;
+        uint32_t m_errors = 0;
+        uint32_t m_busy_us = 0;
+
+        Device* m_next = nullptr;
+        static Device* m_first;
+    };
+
+    void begin();
+
+    // Write `prefix` (register, command or control byte) and `data`
+    // (at most 127 bytes with the prefix - Wire buffer on ESP8266)
+    bool write(Device& dev, uint8_t prefix, const uint8_t* data, size_t length);
+
+    // Read `length` bytes (not more than 128)
+    bool read(Device& dev, uint8_t* data, size_t length);
+
+    // A library call which drives `Wire` on its own, `fn()` returns true on success
+    template <typename F>
+    bool run(Device& dev, const F& fn) {
+        uint32_t start = select(dev);
+        bool ok = fn();
+        done(dev, start, ok);
+        m_clock = 0;  // the library may call Wire.begin(), which resets the clock
+        return ok;
+    }
+
+    // Print utilisation and errors since the last report, reset the counters
+    void report(Print& out);
+
+private:
+    // Set clock for the device, returns start time (micros)
+    uint32_t select(Device& dev);
+    void done(Device& dev, uint32_t start, bool ok);
+
+    uint32_t m_clock = 0;
+    uint32_t m_report_time = 0;     // micros() of last report
+};
+
+extern I2CBus i2c_bus;
+
+#endif // WITH_I2C
+
+#endif // include guard
@@ -0,0 +1,117 @@
+// Log.cpp - created by Radek Brich on 2026-10-19
+
+#include "Log.h"
+#include "HeapCheck.h"
+#include <stdarg.h>
+
+#ifdef SIM_HOST
+thread_local Log logger;
+#else
+Log logger;
+#endif
+
+static constexpr uint32_t mask = LOG_BUFFER_SIZE - 1;
+
+
+void Log::begin()
+{
+#ifdef LOG_TELNET_PORT
+    m_server.begin();
+    m_server.setNoDelay(true);
+#endif
+}
+
+
+size_t Log::write(uint8_t c)
+{
+    m_buffer[m_head & mask] = (char) c;
+    ++m_head;
+    return 1;
+}
+
+
+size_t Log::write(const uint8_t* buffer, size_t size)
+{
+    for (size_t i = 0; i != size; ++i) {
+        m_buffer[m_head & mask] = (char) buffer[i];
+        ++m_head;
+    }
+    return size;
+}
+
+
+size_t Log::printf(const char* format, ...)
+{
+    char message[max_message];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    return write_message(message, len);
+}
+
+
+size_t Log::printf_P(PGM_P format, ...)
+{
+    char message[max_message];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf_P(message, sizeof(message), format, args);
+    va_end(args);
+    return write_message(message, len);
+}
+
+
+size_t Log::write_message(const char* message, int len)
+{
+    if (len < 0)
+        return 0;
+    return write((const uint8_t*) message, min(size_t(len), size_t(max_message) - 1));
+}
+
+
+void Log::drain(Print& out, uint32_t& pos, size_t room)
+{
+    // The reader was overtaken, skip the overwritten data
+    if (m_head - pos > LOG_BUFFER_SIZE)
+        pos = m_head - LOG_BUFFER_SIZE;
+    while (room != 0 && pos != m_head) {
+        // contiguous part up to the end of the buffer
+        size_t begin = pos & mask;
+        size_t len = min(size_t(m_head - pos), LOG_BUFFER_SIZE - begin);
+        len = out.write((const uint8_t*) &m_buffer[begin], min(len, room));
+        if (len == 0)
+            break;
+        pos += len;
+        room -= len;
+    }
+}
+
+
+void Log::loop()
+{
+    int room = Serial.availableForWrite();
+    if (room > 0)
+        drain(Serial, m_uart_pos, room);
+
+#ifdef LOG_TELNET_PORT
+    heap_check::Pause pause;
+    if (m_server.hasClient()) {
+        // The new connection replaces the old one, starts with the history
+        m_client = m_server.available();
+        m_client_pos = m_head > LOG_BUFFER_SIZE ? m_head - LOG_BUFFER_SIZE : 0;
+    }
+    if (m_client && m_client.connected()) {
+        room = m_client.availableForWrite();
+        if (room > 0)
+            drain(m_client, m_client_pos, room);
+    }
+#endif
+}
+
+
+void Log::flush()
+{
+    drain(Serial, m_uart_pos, LOG_BUFFER_SIZE);
+    Serial.flush();
+}
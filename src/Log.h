@@ -0,0 +1,114 @@
+// Log.h - created by Radek Brich on 2026-10-19
+
+#ifndef GADGETS_LOG_H
+#define GADGETS_LOG_H
+
+#include <Arduino.h>
+#include <Print.h>
+#include <stdint.h>
+
+#ifdef LOG_TELNET_PORT
+#include <ESP8266WiFi.h>
+#endif
+
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+
+// Messages above this level are removed at compile time: the call
+// is dead code, its arguments and format strings are not in the binary
+// (but they are still type checked)
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// Must be a power of two
+#ifndef LOG_BUFFER_SIZE
+#define LOG_BUFFER_SIZE 1024
+#endif
+
+// Log messages are formatted into a RAM ring buffer, `loop()` drains it
+// to UART as far as the TX FIFO has room, so logging never blocks.
+// When the buffer overflows, the oldest data are overwritten.
+//
+// With -DLOG_TELNET_PORT=23, the log can be read remotely (`telnet <device>`).
+// A new connection gets the buffered history first, then follows the log.
+//
+// The LOG_* macros keep their format strings in flash (PSTR).
+//
+// Not for use in interrupt handlers.
+class Log: public Print {
+public:
+    // Start telnet server (if enabled)
+    void begin();
+
+    // Copy buffered data to UART and telnet client, without blocking
+    void loop();
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+
+    // Messages longer than `max_message` are truncated
+    size_t printf(const char* format, ...) __attribute__ ((format (printf, 2, 3)));
+    // Format string in flash: `logger.printf_P(PSTR("%d\n"), n)`
+    size_t printf_P(PGM_P format, ...) __attribute__ ((format (printf, 2, 3)));
+    static constexpr size_t max_message = 160;
+
+    // Drain all to UART, blocking (before abort or reset)
+    void flush() override;
+
+private:
+    // Write formatted message, `len` as returned by vsnprintf
+    size_t write_message(const char* message, int len);
+
+    // Send data after `pos` (at most `room` bytes), advance `pos`
+    void drain(Print& out, uint32_t& pos, size_t room);
+
+    static_assert((LOG_BUFFER_SIZE & (LOG_BUFFER_SIZE - 1)) == 0,
+                  "LOG_BUFFER_SIZE must be a power of two");
+    char m_buffer[LOG_BUFFER_SIZE];
+    uint32_t m_head = 0;  // total bytes written (wraps)
+    uint32_t m_uart_pos = 0;
+
+#ifdef LOG_TELNET_PORT
+    WiFiServer m_server {LOG_TELNET_PORT};
+    WiFiClient m_client;
+    uint32_t m_client_pos = 0;
+#endif
+};
+
+// One log per device (per thread in the fleet simulator)
+#ifdef SIM_HOST
+extern thread_local Log logger;
+#else
+extern Log logger;
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(format, ...) logger.printf_P(PSTR(format), ##__VA_ARGS__)
+#else
+#define LOG_ERROR(format, ...) do { if (false) logger.printf(format, ##__VA_ARGS__); } while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(format, ...) logger.printf_P(PSTR(format), ##__VA_ARGS__)
+#else
+#define LOG_WARN(format, ...) do { if (false) logger.printf(format, ##__VA_ARGS__); } while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(format, ...) logger.printf_P(PSTR(format), ##__VA_ARGS__)
+#else
+#define LOG_INFO(format, ...) do { if (false) logger.printf(format, ##__VA_ARGS__); } while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(format, ...) logger.printf_P(PSTR(format), ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(format, ...) do { if (false) logger.printf(format, ##__VA_ARGS__); } while (0)
+#endif
+
+#endif // include guard
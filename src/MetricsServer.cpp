@@ -0,0 +1,263 @@
+// MetricsServer.cpp - created by Radek Brich on 2026-10-19
+
+#ifdef WITH_METRICS
+
+#include "MetricsServer.h"
+#include "HeapCheck.h"
+#include "Log.h"
+#include "Sensor.h"
+#include <string.h>
+
+MetricsServer metrics;
+
+// Space for the response header, before the body
+static constexpr size_t header_room = 128;
+
+
+namespace {
+
+// Print into a fixed buffer, the overflow is remembered
+class BufferWriter: public Print {
+public:
+    BufferWriter(char* buffer, size_t size) : m_buffer(buffer), m_size(size) {}
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* data, size_t length) override {
+        if (length > m_size - m_length) {
+            m_overflow = true;
+            return 0;
+        }
+        memcpy(m_buffer + m_length, data, length);
+        m_length += length;
+        return length;
+    }
+    using Print::write;
+
+    size_t length() const { return m_length; }
+    bool overflow() const { return m_overflow; }
+
+private:
+    char* m_buffer;
+    size_t m_size;
+    size_t m_length = 0;
+    bool m_overflow = false;
+};
+
+} // namespace
+
+
+// "{measurement="temperature",sensor="SHT30"} "
+static void print_labels(Print& out, const char* measurement, const char* sensor)
+{
+    out.print(F("{measurement=\""));
+    out.print(measurement);
+    out.print(F("\",sensor=\""));
+    out.print(sensor);
+    out.print(F("\"} "));
+}
+
+
+// Milliseconds as seconds with 3 decimal places
+static void print_seconds(Print& out, unsigned long ms)
+{
+    out.printf_P(PSTR("%lu.%03lu\n"), ms / 1000, ms % 1000);
+}
+
+
+void MetricsServer::begin()
+{
+    m_server.begin();
+    m_server.setNoDelay(true);
+}
+
+
+void MetricsServer::loop()
+{
+    heap_check::Pause pause;
+    accept();
+    for (Client& client : m_clients) {
+        if (client.state == Client::State::Free)
+            continue;
+        if (client.state == Client::State::Request)
+            receive(client);
+        if (client.state == Client::State::Response)
+            transmit(client);
+        if (client.state == Client::State::Draining
+        && client.conn.availableForWrite() >= client.room)
+            close(client);
+        if (client.state == Client::State::Free)
+            continue;
+        if (!client.conn.connected() || millis() - client.active > METRICS_TIMEOUT)
+            close(client);
+    }
+}
+
+
+void MetricsServer::accept()
+{
+    if (!m_server.hasClient())
+        return;
+    for (Client& client : m_clients) {
+        if (client.state == Client::State::Free) {
+            client.conn = m_server.available();
+            client.room = client.conn.availableForWrite();
+            client.state = Client::State::Request;
+            client.headers = false;
+            client.blank = true;
+            client.request_len = 0;
+            client.active = millis();
+            return;
+        }
+    }
+    // All slots busy, the scraper retries on next interval
+    LOG_DEBUG("[metrics] Connection refused, %d clients\n", METRICS_CLIENTS);
+    m_server.available().stop();
+}
+
+
+void MetricsServer::receive(Client& client)
+{
+    while (client.conn.available()) {
+        int c = client.conn.read();
+        client.active = millis();
+        if (c == '\r')
+            continue;
+        if (c != '\n') {
+            if (!client.headers && client.request_len < sizeof(client.request))
+                client.request[client.request_len++] = char(c);
+            client.blank = false;
+            continue;
+        }
+        // Empty line ends the headers, the request has no body
+        if (client.blank) {
+            respond(client);
+            return;
+        }
+        client.headers = true;
+        client.blank = true;
+    }
+}
+
+
+void MetricsServer::respond(Client& client)
+{
+    // "GET /metrics HTTP/1.1", "GET /metrics?..."
+    static constexpr size_t path_len = 12;
+    bool found = client.request_len >= path_len
+            && strncmp_P(client.request, PSTR("GET /metrics"), path_len) == 0
+            && (client.request_len == path_len || client.request[path_len] == ' '
+                || client.request[path_len] == '?');
+    if (!found) {
+        client.conn.print(F("HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n"));
+        drain(client);
+        return;
+    }
+
+    // Rendered response is shared while being sent, the values
+    // in it are at most one transfer older than the current ones
+    if (m_readers == 0 && !render()) {
+        LOG_WARN("[metrics] Response too long, increase METRICS_BUFFER_SIZE\n");
+        client.conn.print(F("HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\nConnection: close\r\n\r\n"));
+        drain(client);
+        return;
+    }
+    ++m_readers;
+    client.state = Client::State::Response;
+    client.sent = 0;
+}
+
+
+void MetricsServer::transmit(Client& client)
+{
+    size_t length = m_end - m_begin;
+    int room = client.conn.availableForWrite();
+    if (room > 0 && client.sent != length) {
+        size_t n = client.conn.write((const uint8_t*) m_buffer + m_begin + client.sent,
+                                     min(size_t(room), length - client.sent));
+        if (n != 0) {
+            client.sent += n;
+            client.active = millis();
+        }
+    }
+    if (client.sent == length)
+        drain(client);
+}
+
+
+// Response written, wait for its ACK before closing. stop() would wait
+// for it in flush(), up to 300 ms - with a slow scraper, that blocks loop().
+void MetricsServer::drain(Client& client)
+{
+    if (client.state == Client::State::Response)
+        --m_readers;
+    client.state = Client::State::Draining;
+    client.active = millis();
+}
+
+
+void MetricsServer::close(Client& client)
+{
+    if (client.state == Client::State::Response)
+        --m_readers;
+    // Drained already, or given up (timeout, closed by peer) - don't flush
+    client.conn.stop(0);
+    client.state = Client::State::Free;
+}
+
+
+bool MetricsServer::render()
+{
+    m_begin = m_end = 0;
+    BufferWriter out(m_buffer + header_room, sizeof(m_buffer) - header_room);
+
+    // Each family in one block, as Prometheus wants it
+    out.print(F("# HELP gadget_sensor_value Last sampled value\n"
+                "# TYPE gadget_sensor_value gauge\n"));
+    Sensor::for_each([&out](Sensor& sensor) {
+        if (!sensor.sampled())
+            return;
+        sensor.output_values([&out](const char* measurement, const char* name, float value) {
+            out.print(F("gadget_sensor_value"));
+            print_labels(out, measurement, name);
+            out.print(value, 3);
+            out.print('\n');
+        });
+    });
+
+    out.print(F("# HELP gadget_sensor_age_seconds Time since the value was sampled\n"
+                "# TYPE gadget_sensor_age_seconds gauge\n"));
+    Sensor::for_each([&out](Sensor& sensor) {
+        if (!sensor.sampled())
+            return;
+        unsigned long age = sensor.age();
+        sensor.output_values([&out, age](const char* measurement, const char* name, float) {
+            out.print(F("gadget_sensor_age_seconds"));
+            print_labels(out, measurement, name);
+            print_seconds(out, age);
+        });
+    });
+
+    out.print(F("# HELP gadget_uptime_seconds Time since boot\n"
+                "# TYPE gadget_uptime_seconds gauge\n"
+                "gadget_uptime_seconds "));
+    print_seconds(out, millis());
+
+    if (out.overflow())
+        return false;
+
+    char header[header_room];
+    int len = snprintf_P(header, sizeof(header), PSTR(
+            "HTTP/1.1 200 OK\r\n"
+            "Content-Type: text/plain; version=0.0.4\r\n"
+            "Content-Length: %u\r\n"
+            "Connection: close\r\n\r\n"),
+            (unsigned) out.length());
+    if (len < 0 || size_t(len) >= sizeof(header))
+        return false;
+    m_begin = header_room - len;
+    memcpy(m_buffer + m_begin, header, len);
+    m_end = header_room + out.length();
+    return true;
+}
+
+#endif // WITH_METRICS
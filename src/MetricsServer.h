@@ -0,0 +1,84 @@
+// MetricsServer.h - created by Radek Brich on 2026-10-19
+
+#ifndef GADGETS_METRICSSERVER_H
+#define GADGETS_METRICSSERVER_H
+
+#ifdef WITH_METRICS
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+// Prometheus scrape target: http://<device>:METRICS_PORT/metrics
+#ifndef METRICS_PORT
+#define METRICS_PORT 80
+#endif
+
+// Scrapers served at once, another connection is refused
+#ifndef METRICS_CLIENTS
+#define METRICS_CLIENTS 3
+#endif
+
+// Whole response (headers + all values)
+#ifndef METRICS_BUFFER_SIZE
+#define METRICS_BUFFER_SIZE 1024
+#endif
+
+// Idle connection (slow request, stalled reader) is closed after this, ms
+#ifndef METRICS_TIMEOUT
+#define METRICS_TIMEOUT 3000
+#endif
+
+// HTTP server with the cached sensor values in Prometheus text format.
+//
+// A scrape doesn't read the sensors: it gets what `Sensor::output_values()`
+// has from the last `read()` in the send cycle, with its age.
+//
+// `loop()` never waits: it reads what has arrived, and writes as much as
+// the TCP buffer takes. The response is rendered into one buffer, shared
+// by the clients being served - a new one is rendered when the buffer is free.
+class MetricsServer {
+public:
+    void begin();
+
+    // Accept, read requests, send responses - call this on every loop pass
+    void loop();
+
+private:
+    struct Client {
+        enum class State: uint8_t { Free, Request, Response, Draining };
+        WiFiClient conn;
+        State state = State::Free;
+        bool headers = false;       // past the request line
+        bool blank = true;          // current line is empty so far
+        uint8_t request_len = 0;
+        char request[16];           // start of the request line
+        size_t sent = 0;            // bytes of the response
+        int room = 0;               // availableForWrite() with nothing unacked
+        unsigned long active = 0;   // millis() of last progress
+    };
+
+    void accept();
+    void receive(Client& client);
+    void respond(Client& client);
+    void transmit(Client& client);
+    void drain(Client& client);
+    void close(Client& client);
+
+    // Render the response into `m_buffer`, false if it doesn't fit
+    bool render();
+
+    WiFiServer m_server {METRICS_PORT};
+    Client m_clients[METRICS_CLIENTS];
+
+    // Response: header is right-aligned before the body
+    char m_buffer[METRICS_BUFFER_SIZE];
+    size_t m_begin = 0;
+    size_t m_end = 0;
+    uint8_t m_readers = 0;          // clients sending the response
+};
+
+extern MetricsServer metrics;
+
+#endif // WITH_METRICS
+
+#endif // include guard
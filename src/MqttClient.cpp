@@ -0,0 +1,146 @@
+// MqttClient.cpp - created by Radek Brich on 2026-10-19
+
+#include "config.h"
+#include "MqttClient.h"
+#include "HeapCheck.h"
+#include "Log.h"
+
+#ifndef MQTT_PREFIX
+#define MQTT_PREFIX "gadgets/" DEVICE_NAME
+#endif
+
+static constexpr unsigned long backoff_min = 2000;  // ms
+static constexpr unsigned long backoff_max = 60000;  // ms
+
+MqttClient* MqttClient::m_instance = nullptr;
+
+
+void MqttClient::begin(const CommandCallback& cmd_cb)
+{
+    m_instance = this;
+    m_cmd_cb = cmd_cb;
+    m_mqtt.begin(MQTT_HOST, MQTT_PORT, m_net);
+    // the advanced callback gets the raw buffer, without String copies
+    m_mqtt.onMessageAdvanced(on_message);
+    // keepAlive [s], cleanSession, timeout [ms]
+    m_mqtt.setOptions(60, false, 2000);
+    m_mqtt.setWill(MQTT_PREFIX "/status", "offline", true, 1);
+}
+
+
+bool MqttClient::connect()
+{
+    heap_check::Pause pause;
+    LOG_INFO("* MQTT connecting to " MQTT_HOST " ...\n");
+    m_display.drawText(2, F("MQTT "));
+    m_display.display();
+    if (!m_mqtt.connect(DEVICE_NAME, MQTT_USER, MQTT_PASS)) {
+        LOG_WARN("* MQTT connection failed (%d, %d)\n",
+                 m_mqtt.lastError(), m_mqtt.returnCode());
+        m_display.appendText(F("FAIL"));
+        m_display.display();
+        return false;
+    }
+
+    LOG_INFO("* MQTT connected\n");
+    m_display.appendText(F("OK"));
+    m_display.display();
+    m_mqtt.publish(MQTT_PREFIX "/status", "online", true, 1);
+    // The subscription survives in the persistent session,
+    // renewing it is harmless and covers a broker without persistence
+    m_mqtt.subscribe(MQTT_PREFIX "/control/+", 1);
+    return true;
+}
+
+
+void MqttClient::on_message(MQTTClient*, char topic[], char bytes[], int length)
+{
+    // Called from inside MQTTClient::loop(), must not publish here.
+    // Only queue the message, loop() processes it afterwards.
+    MqttClient& self = *m_instance;
+    const char* slash = strrchr(topic, '/');
+    int seq = slash ? atoi(slash + 1) : 0;
+    if (self.m_queue_len == max_queued) {
+        LOG_ERROR("* MQTT commands dropped, queue full (seq=%d)\n", seq);
+        return;
+    }
+    Message& msg = self.m_queue[(self.m_queue_head + self.m_queue_len++) % max_queued];
+    msg.seq = seq;
+    size_t len = min(size_t(length), max_commands - 1);
+    memcpy(msg.commands, bytes, len);
+    msg.commands[len] = '\0';
+}
+
+
+bool MqttClient::loop()
+{
+    if (!WiFi.isConnected())
+        return false;
+
+    if (!m_mqtt.connected()) {
+        if (m_backoff != 0 && millis() - m_last_attempt < m_backoff)
+            return false;
+        m_last_attempt = millis();
+        if (!connect()) {
+            m_backoff = m_backoff == 0 ? backoff_min : min(m_backoff * 2, backoff_max);
+            return false;
+        }
+        m_backoff = 0;
+    }
+
+    {
+        heap_check::Pause pause;
+        m_mqtt.loop();
+    }
+
+    while (m_queue_len != 0) {
+        const Message& msg = m_queue[m_queue_head];
+        int seq = msg.seq;
+        LOG_INFO("* MQTT commands (seq=%d)\n", seq);
+        m_cmd_cb(seq, msg.commands);
+        m_queue_head = (m_queue_head + 1) % max_queued;
+        --m_queue_len;
+        char ack[12];
+        int len = snprintf_P(ack, sizeof(ack), PSTR("%d"), seq);
+        heap_check::Pause pause;
+        m_mqtt.publish(MQTT_PREFIX "/ack", ack, len, false, 1);
+    }
+
+    return m_mqtt.connected();
+}
+
+
+bool MqttClient::publish(const char* data, int qos)
+{
+    if (!m_mqtt.connected())
+        return false;
+
+    char topic[64] = MQTT_PREFIX "/";
+    const size_t prefix_len = strlen(topic);
+
+    bool ok = true;
+    while (*data != '\0') {
+        const char* end = strchr(data, '\n');
+        if (end == nullptr)
+            end = data + strlen(data);
+        const char* line = data;
+        int length = int(end - line);
+        data = *end ? end + 1 : end;
+        if (length == 0)
+            continue;
+
+        // "temperature,sensor=SHT30,... value=21.5" -> topic ".../temperature"
+        const char* comma = (const char*) memchr(line, ',', length);
+        size_t name_len = min(size_t((comma ? comma : end) - line),
+                              sizeof(topic) - prefix_len - 1);
+        memcpy(topic + prefix_len, line, name_len);
+        topic[prefix_len + name_len] = '\0';
+
+        heap_check::Pause pause;
+        if (!m_mqtt.publish(topic, line, length, false, qos)) {
+            LOG_WARN("* MQTT publish failed (%d)\n", m_mqtt.lastError());
+            ok = false;
+        }
+    }
+    return ok;
+}
@@ -0,0 +1,69 @@
+// MqttClient.h - created by Radek Brich on 2026-10-19
+
+#ifndef GADGETS_MQTTCLIENT_H
+#define GADGETS_MQTTCLIENT_H
+
+#include "Display.h"
+#include <ESP8266WiFi.h>
+#include <MQTT.h>
+#include <functional>
+
+// Persistent MQTT session for telemetry and commands.
+//
+// Topics (prefix is MQTT_PREFIX, e.g. "gadgets/<device>"):
+// - <prefix>/<measurement>     telemetry, one line-protocol line per message
+// - <prefix>/control/<seq>     commands for the device (subscribed, QoS 1)
+// - <prefix>/ack               seq of processed commands
+// - <prefix>/status            "online" / "offline" (retained, last will)
+//
+// The session is not clean, so the broker keeps commands sent
+// while the device was offline and delivers them on reconnect.
+class MqttClient {
+public:
+    using CommandCallback = std::function<void(int seq, const char* commands)>;
+
+    explicit MqttClient(Display& display) : m_display(display) {}
+
+    void begin(const CommandCallback& cmd_cb);
+
+    // Keep the connection alive, reconnect when lost, deliver commands.
+    // Call this often, commands are received only here.
+    bool loop();
+
+    // Publish `data` (line protocol), each line to its measurement topic
+    // Returns false if not connected or a publish failed.
+    bool publish(const char* data, int qos);
+
+    // Longer command payloads are truncated
+    static constexpr size_t max_commands = 256;
+    // Messages received in one MQTTClient::loop() (queued in the session
+    // while offline), more are dropped - they're already acknowledged
+    static constexpr uint8_t max_queued = 4;
+
+private:
+    bool connect();
+    static void on_message(MQTTClient* client, char topic[], char bytes[], int length);
+
+private:
+    WiFiClient m_net;
+    MQTTClient m_mqtt {512};
+    Display& m_display;
+    CommandCallback m_cmd_cb;
+
+    // reconnect backoff
+    unsigned long m_last_attempt = 0;
+    unsigned long m_backoff = 0;
+
+    // messages received in on_message(), processed in loop(), oldest first
+    struct Message {
+        int seq;
+        char commands[max_commands];
+    };
+    Message m_queue[max_queued];
+    uint8_t m_queue_head = 0;
+    uint8_t m_queue_len = 0;
+
+    static MqttClient* m_instance;
+};
+
+#endif // include guard
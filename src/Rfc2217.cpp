@@ -0,0 +1,336 @@
+// Rfc2217.cpp - created by Radek Brich on 2026-10-19
+
+#include "Rfc2217.h"
+#include <string.h>
+
+// Telnet (RFC 854)
+static constexpr uint8_t SE = 240;
+static constexpr uint8_t SB = 250;
+static constexpr uint8_t WILL = 251;
+static constexpr uint8_t WONT = 252;
+static constexpr uint8_t DO = 253;
+static constexpr uint8_t DONT = 254;
+static constexpr uint8_t IAC = 255;
+
+// Options
+static constexpr uint8_t BINARY = 0;
+static constexpr uint8_t SGA = 3;  // suppress go ahead
+static constexpr uint8_t COM_PORT_OPTION = 44;
+
+// COM port commands (client -> server, the server replies with +100)
+static constexpr uint8_t SIGNATURE = 0;
+static constexpr uint8_t SET_BAUDRATE = 1;
+static constexpr uint8_t SET_DATASIZE = 2;
+static constexpr uint8_t SET_PARITY = 3;
+static constexpr uint8_t SET_STOPSIZE = 4;
+static constexpr uint8_t SET_CONTROL = 5;
+static constexpr uint8_t PURGE_DATA = 12;
+static constexpr uint8_t SERVER_OFFSET = 100;
+
+static constexpr const char* signature = "gadgets wifi_serial";
+
+
+static constexpr uint64_t bit(uint8_t option) { return uint64_t(1) << option; }
+
+// Options we agree to enable
+static constexpr uint64_t supported_local = bit(BINARY) | bit(SGA);
+static constexpr uint64_t supported_remote = bit(BINARY) | bit(SGA) | bit(COM_PORT_OPTION);
+
+
+void Rfc2217::begin(uint32_t baudrate)
+{
+    m_state = State::Data;
+    m_reply_len = 0;
+    m_baudrate = baudrate;
+    m_data_bits = 8;
+    m_parity = 1;
+    m_stop_bits = 1;
+    m_dtr = false;
+    m_rts = false;
+
+    // Requested options are marked as enabled, the client's answer
+    // then doesn't trigger another reply (RFC 854 loop prevention)
+    m_local = bit(BINARY);
+    m_remote = bit(BINARY) | bit(COM_PORT_OPTION);
+    send_option(WILL, BINARY);
+    send_option(DO, BINARY);
+    send_option(DO, COM_PORT_OPTION);
+}
+
+
+size_t Rfc2217::decode(uint8_t* data, size_t length)
+{
+    size_t out = 0;
+    for (size_t i = 0; i != length; ++i) {
+        uint8_t b = data[i];
+        switch (m_state) {
+            case State::Data:
+                if (b == IAC)
+                    m_state = State::Iac;
+                else
+                    data[out++] = b;
+                break;
+
+            case State::Iac:
+                m_state = State::Data;
+                if (b == IAC) {
+                    // escaped 0xFF
+                    data[out++] = b;
+                } else if (b == WILL || b == WONT || b == DO || b == DONT) {
+                    m_cmd = b;
+                    m_state = State::Option;
+                } else if (b == SB) {
+                    m_sub_len = 0;
+                    m_state = State::Sub;
+                }
+                // other commands (NOP, BRK, ...) are ignored
+                break;
+
+            case State::Option:
+                on_option(m_cmd, b);
+                m_state = State::Data;
+                break;
+
+            case State::Sub:
+                if (b == IAC)
+                    m_state = State::SubIac;
+                else if (m_sub_len < sizeof(m_sub))
+                    m_sub[m_sub_len++] = b;
+                break;
+
+            case State::SubIac:
+                if (b == SE) {
+                    on_subnegotiation();
+                    m_state = State::Data;
+                } else {
+                    // IAC IAC is 0xFF in the value
+                    if (b == IAC && m_sub_len < sizeof(m_sub))
+                        m_sub[m_sub_len++] = b;
+                    m_state = State::Sub;
+                }
+                break;
+        }
+    }
+    return out;
+}
+
+
+size_t Rfc2217::encode(const uint8_t* in, size_t length, uint8_t* out)
+{
+    size_t out_len = 0;
+    for (size_t i = 0; i != length; ++i) {
+        out[out_len++] = in[i];
+        if (in[i] == IAC)
+            out[out_len++] = IAC;
+    }
+    return out_len;
+}
+
+
+void Rfc2217::on_option(uint8_t cmd, uint8_t option)
+{
+    if (option >= 64) {
+        if (cmd == WILL)
+            send_option(DONT, option);
+        else if (cmd == DO)
+            send_option(WONT, option);
+        return;
+    }
+
+    // Reply only on change of the state
+    switch (cmd) {
+        case WILL:
+            if (!(supported_remote & bit(option)))
+                send_option(DONT, option);
+            else if (!(m_remote & bit(option))) {
+                m_remote |= bit(option);
+                send_option(DO, option);
+            }
+            break;
+        case WONT:
+            if (m_remote & bit(option)) {
+                m_remote &= ~bit(option);
+                send_option(DONT, option);
+            }
+            break;
+        case DO:
+            if (!(supported_local & bit(option)))
+                send_option(WONT, option);
+            else if (!(m_local & bit(option))) {
+                m_local |= bit(option);
+                send_option(WILL, option);
+            }
+            break;
+        case DONT:
+            if (m_local & bit(option)) {
+                m_local &= ~bit(option);
+                send_option(WONT, option);
+            }
+            break;
+    }
+}
+
+
+void Rfc2217::on_subnegotiation()
+{
+    if (m_sub_len < 2 || m_sub[0] != COM_PORT_OPTION)
+        return;
+    const uint8_t cmd = m_sub[1];
+    const uint8_t* value = m_sub + 2;
+    const size_t length = m_sub_len - 2;
+
+    switch (cmd) {
+        case SIGNATURE:
+            // empty = request for our signature, otherwise client's signature
+            if (length == 0)
+                send_com_port(SIGNATURE, (const uint8_t*) signature, strlen(signature));
+            return;
+
+        case SET_BAUDRATE: {
+            if (length != 4)
+                return;
+            uint32_t baudrate = uint32_t(value[0]) << 24 | uint32_t(value[1]) << 16
+                              | uint32_t(value[2]) << 8 | value[3];
+            // 0 = query current value
+            if (baudrate != 0 && baudrate != m_baudrate) {
+                m_baudrate = baudrate;
+                m_port.set_baudrate(baudrate);
+            }
+            const uint8_t reply[4] = {uint8_t(m_baudrate >> 24), uint8_t(m_baudrate >> 16),
+                                      uint8_t(m_baudrate >> 8), uint8_t(m_baudrate)};
+            send_com_port(cmd, reply, sizeof(reply));
+            return;
+        }
+
+        case SET_DATASIZE:
+        case SET_PARITY:
+        case SET_STOPSIZE: {
+            if (length != 1)
+                return;
+            uint8_t v = value[0];
+            bool changed = false;
+            if (cmd == SET_DATASIZE && v >= 5 && v <= 8 && v != m_data_bits) {
+                m_data_bits = v;
+                changed = true;
+            }
+            // 4, 5 = mark, space, not supported
+            if (cmd == SET_PARITY && v >= 1 && v <= 3 && v != m_parity) {
+                m_parity = v;
+                changed = true;
+            }
+            // 3 = 1.5 stop bits, not supported
+            if (cmd == SET_STOPSIZE && (v == 1 || v == 2) && v != m_stop_bits) {
+                m_stop_bits = v;
+                changed = true;
+            }
+            if (changed)
+                m_port.set_format(m_data_bits, "NOE"[m_parity - 1], m_stop_bits);
+
+            uint8_t reply;
+            if (cmd == SET_DATASIZE)
+                reply = m_data_bits;
+            else if (cmd == SET_PARITY)
+                reply = m_parity;
+            else
+                reply = m_stop_bits;
+            send_com_port(cmd, &reply, 1);
+            return;
+        }
+
+        case SET_CONTROL:
+            if (length == 1)
+                on_control(value[0]);
+            return;
+
+        case PURGE_DATA:
+            // 1 = access server's receive buffer (data from the serial port,
+            // pyserial's reset_input_buffer()), 2 = transmit buffer (data
+            // to the serial port), 3 = both
+            if (length == 1 && value[0] >= 1 && value[0] <= 3)
+                m_port.purge(value[0] & 1, value[0] & 2);
+            send_com_port(cmd, value, length);
+            return;
+
+        default:
+            // flow control suspend/resume, notification masks - acknowledged only
+            send_com_port(cmd, value, length);
+            return;
+    }
+}
+
+
+void Rfc2217::on_control(uint8_t value)
+{
+    uint8_t reply = value;
+    switch (value) {
+        case 0:     // request outbound flow control setting
+        case 2:     // XON/XOFF (not supported)
+        case 3:     // hardware (not supported)
+            reply = 1;  // no flow control
+            break;
+        case 4:     // request BREAK state
+        case 5:     // BREAK on (not supported)
+            reply = 6;  // BREAK off
+            break;
+        case 7:     // request DTR state
+            reply = m_dtr ? 8 : 9;
+            break;
+        case 8:     // DTR on
+        case 9:     // DTR off
+            if ((value == 8) != m_dtr) {
+                m_dtr = (value == 8);
+                m_port.set_dtr(m_dtr);
+            }
+            break;
+        case 10:    // request RTS state
+            reply = m_rts ? 11 : 12;
+            break;
+        case 11:    // RTS on
+        case 12:    // RTS off
+            if ((value == 11) != m_rts) {
+                m_rts = (value == 11);
+                m_port.set_rts(m_rts);
+            }
+            break;
+        case 13:    // request inbound flow control setting
+        case 15:    // XON/XOFF (not supported)
+        case 16:    // hardware (not supported)
+            reply = 14;  // no inbound flow control
+            break;
+    }
+    send_com_port(SET_CONTROL, &reply, 1);
+}
+
+
+void Rfc2217::send_option(uint8_t cmd, uint8_t option)
+{
+    if (m_reply_len + 3 > sizeof(m_reply))
+        return;
+    m_reply[m_reply_len++] = IAC;
+    m_reply[m_reply_len++] = cmd;
+    m_reply[m_reply_len++] = option;
+}
+
+
+void Rfc2217::send_com_port(uint8_t cmd, const uint8_t* value, size_t length)
+{
+    // worst case: every byte of the value is escaped
+    if (m_reply_len + 6 + 2 * length > sizeof(m_reply))
+        return;
+    m_reply[m_reply_len++] = IAC;
+    m_reply[m_reply_len++] = SB;
+    m_reply[m_reply_len++] = COM_PORT_OPTION;
+    m_reply[m_reply_len++] = uint8_t(cmd + SERVER_OFFSET);
+    for (size_t i = 0; i != length; ++i)
+        send_byte(value[i]);
+    m_reply[m_reply_len++] = IAC;
+    m_reply[m_reply_len++] = SE;
+}
+
+
+void Rfc2217::send_byte(uint8_t b)
+{
+    m_reply[m_reply_len++] = b;
+    if (b == IAC)
+        m_reply[m_reply_len++] = IAC;
+}
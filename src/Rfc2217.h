@@ -0,0 +1,93 @@
+// Rfc2217.h - created by Radek Brich on 2026-10-19
+
+#ifndef GADGETS_RFC2217_H
+#define GADGETS_RFC2217_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Telnet COM Port Control Option (RFC 2217), server side.
+//
+// Filters telnet commands out of the data received from the client,
+// answers option negotiation and COM port commands (baud rate, data format,
+// DTR/RTS, purge), escapes IAC (0xFF) in the data sent to the client.
+// Tested with pyserial (URL `rfc2217://<host>:<port>`).
+class Rfc2217 {
+public:
+    // Serial port controlled by the client
+    class Port {
+    public:
+        virtual void set_baudrate(uint32_t baudrate) = 0;
+        // data_bits: 5..8, parity: 'N', 'O', 'E', stop_bits: 1, 2
+        virtual void set_format(uint8_t data_bits, char parity, uint8_t stop_bits) = 0;
+        virtual void set_dtr(bool active) = 0;
+        virtual void set_rts(bool active) = 0;
+        // Discard buffered data: `rx` received from the serial port
+        // (not yet sent to the client), `tx` to be transmitted to it
+        virtual void purge(bool rx, bool tx) = 0;
+
+    protected:
+        ~Port() = default;
+    };
+
+    explicit Rfc2217(Port& port) : m_port(port) {}
+
+    // New connection: reset the state, request binary mode and COM port option
+    // (the requests are in `reply()`)
+    void begin(uint32_t baudrate);
+
+    // Remove telnet commands from data received from the client, in place.
+    // Returns length of the remaining data for the serial port.
+    size_t decode(uint8_t* data, size_t length);
+
+    // Escape data for the client, `out` must have room for `2 * length` bytes.
+    // Returns length of the escaped data.
+    static size_t encode(const uint8_t* in, size_t length, uint8_t* out);
+
+    // Pending replies for the client, send them before more data
+    const uint8_t* reply() const { return m_reply; }
+    size_t reply_length() const { return m_reply_len; }
+    void clear_reply() { m_reply_len = 0; }
+
+private:
+    void on_option(uint8_t cmd, uint8_t option);
+    void on_subnegotiation();
+    void on_control(uint8_t value);
+
+    void send_option(uint8_t cmd, uint8_t option);
+    // COM port reply: IAC SB COM-PORT-OPTION <cmd + 100> <value...> IAC SE
+    void send_com_port(uint8_t cmd, const uint8_t* value, size_t length);
+    void send_byte(uint8_t b);
+
+    enum class State: uint8_t {
+        Data,
+        Iac,        // after IAC
+        Option,     // after IAC WILL/WONT/DO/DONT
+        Sub,        // in IAC SB ... IAC SE
+        SubIac,     // IAC in subnegotiation
+    };
+
+    Port& m_port;
+    State m_state = State::Data;
+    uint8_t m_cmd = 0;              // WILL/WONT/DO/DONT waiting for option
+
+    uint8_t m_sub[16];              // subnegotiation (without IAC SB / IAC SE)
+    size_t m_sub_len = 0;
+
+    uint8_t m_reply[64];
+    size_t m_reply_len = 0;
+
+    // enabled options (bit = option number, only 0..63 are supported)
+    uint64_t m_local = 0;           // we WILL
+    uint64_t m_remote = 0;          // they WILL
+
+    // current port settings
+    uint32_t m_baudrate = 0;
+    uint8_t m_data_bits = 8;
+    uint8_t m_parity = 1;          // 1 = none, 2 = odd, 3 = even
+    uint8_t m_stop_bits = 1;
+    bool m_dtr = false;
+    bool m_rts = false;
+};
+
+#endif // include guard
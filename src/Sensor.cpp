@@ -2,32 +2,80 @@
 
 #include "config.h"
 #include "Sensor.h"
+#include "Log.h"
+#include "Trace.h"
 
 
 Sensor* Sensor::m_first = nullptr;
 
 
+unsigned long Sensor::read()
+{
+    if (!m_pending && !start())
+        return age();
+    finish();
+    return 0;
+}
+
+
+bool Sensor::start()
+{
+    auto now = millis();
+    if (m_pending || (m_period != 0 && m_sampled && now - m_sample_time < m_period))
+        return false;
+    m_sample_time = now;
+    m_pending = true;
+    m_conversion = convert();
+    return true;
+}
+
+
+void Sensor::finish()
+{
+    if (!m_pending)
+        return;
+    auto elapsed = millis() - m_sample_time;
+    if (elapsed < m_conversion)
+        delay(m_conversion - elapsed);
+    m_pending = false;
+    m_sampled = true;
+    sample();
+#ifdef WITH_TRACE
+    output_values([](const char* measurement, const char* sensor, float value) {
+        trace::sensor(measurement, sensor, value);
+    });
+#endif
+}
+
+
 #ifdef WITH_LDR
 
 static LDRSensor s_ldr_sensor;
 
-LDRSensor::LDRSensor()
+// Analog pin, cheap to read
+LDRSensor::LDRSensor() noexcept : Sensor(1000)
 {
     Sensor::add(&s_ldr_sensor);
 }
 
-void LDRSensor::output_to_stream(Stream& stream)
+void LDRSensor::output_to_stream(Print& stream)
 {
-    stream.print("LDR: ");
+    stream.print(F("LDR: "));
     stream.println(m_value);
 }
 
 
-void LDRSensor::output_to_database(String& query)
+void LDRSensor::output_to_database(Print& query)
 {
-    query.concat("ambient_light,sensor=LDR," DEVICE_TAGS " value=");
-    query.concat(m_value);
-    query.concat('\n');
+    query.print(F("ambient_light,sensor=LDR," DEVICE_TAGS " value="));
+    query.print(m_value);
+    query.print('\n');
+}
+
+
+void LDRSensor::output_values(const ValueCallback& fn)
+{
+    fn("ambient_light", "LDR", (float) m_value);
 }
 
 #endif
@@ -38,7 +86,8 @@ void LDRSensor::output_to_database(String& query)
 static DallasTempSensor s_dallas_sensor;
 
 
-DallasTempSensor::DallasTempSensor()
+// A 12-bit conversion takes 750 ms, the CPU is free meanwhile
+DallasTempSensor::DallasTempSensor() noexcept : Sensor(30000)
 {
     Sensor::add(&s_dallas_sensor);
 }
@@ -47,60 +96,67 @@ void DallasTempSensor::setup()
 {
     m_sensor.begin();
 
-    Serial.print("[dallas] Found ");
-    Serial.print(m_sensor.getDeviceCount(), DEC);
-    Serial.println(" temperature sensors.");
+    LOG_INFO("[dallas] Found %d temperature sensors.\n", (int) m_sensor.getDeviceCount());
 
     // report parasite power requirements
-    Serial.print("[dallas] Parasite power is: ");
-    if (m_sensor.isParasitePowerMode())
-        Serial.println("ON");
-    else
-        Serial.println("OFF");
+    LOG_INFO("[dallas] Parasite power is: %s\n", m_sensor.isParasitePowerMode() ? "ON" : "OFF");
 
     if (m_sensor.getAddress(m_addr, 0)) {
-        Serial.print("[dallas] Device 0 Address: ");
+        LOG_INFO("[dallas] Device 0 Address: ");
         for (unsigned char ch : m_addr) {
-            if (ch < 16) Serial.print("0");
-            Serial.print(ch, HEX);
+            LOG_INFO("%02X", ch);
         }
-        Serial.println();
+        LOG_INFO("\n");
     } else
-        Serial.println("[dallas] Unable to find address for Device 0");
+        LOG_WARN("[dallas] Unable to find address for Device 0\n");
 
-    Serial.print("[dallas] Device 0 Resolution: ");
     // sensors.setResolution(insideThermometer, 12);
-    Serial.print(m_sensor.getResolution(m_addr), DEC);
-    Serial.println();
+    LOG_INFO("[dallas] Device 0 Resolution: %d\n", (int) m_sensor.getResolution(m_addr));
+
+    // `convert()` doesn't wait, `Sensor::finish()` does
+    m_sensor.setWaitForConversion(false);
 }
 
 
-void DallasTempSensor::read()
+unsigned long DallasTempSensor::convert()
 {
     m_sensor.requestTemperaturesByAddress(m_addr);
+    return m_sensor.millisToWaitForConversion(m_sensor.getResolution(m_addr));
+}
+
+
+void DallasTempSensor::sample()
+{
     m_value = m_sensor.getTempC(m_addr);
     if (m_value == DEVICE_DISCONNECTED_C)
         m_value = 0.f;
 }
 
 
-void DallasTempSensor::output_to_stream(Stream &stream)
+void DallasTempSensor::output_to_stream(Print& stream)
 {
-    stream.print("[dallas] Temperature: ");
+    stream.print(F("[dallas] Temperature: "));
     stream.print(m_value);
-    stream.println("°C");
+    stream.println(F("°C"));
 }
 
 
-void DallasTempSensor::output_to_database(String &query)
+void DallasTempSensor::output_to_database(Print& query)
 {
     if (m_value != 0.f) {
-        query.concat("temperature,sensor=Dallas," DEVICE_TAGS " value=");
-        query.concat(m_value);
-        query.concat('\n');
+        query.print(F("temperature,sensor=Dallas," DEVICE_TAGS " value="));
+        query.print(m_value);
+        query.print('\n');
     }
 }
 
+
+void DallasTempSensor::output_values(const ValueCallback& fn)
+{
+    if (m_value != 0.f)
+        fn("temperature", "Dallas", m_value);
+}
+
 #endif
 
 
@@ -109,53 +165,95 @@ void DallasTempSensor::output_to_database(String &query)
 static SHT30Sensor s_sht30_sensor;
 
 
-SHT30Sensor::SHT30Sensor() noexcept
+// I2C transaction with 15 ms measurement (high repeatability)
+SHT30Sensor::SHT30Sensor() noexcept : Sensor(10000)
 {
     Sensor::add(&s_sht30_sensor);
 }
 
 
-void SHT30Sensor::read()
+// CRC-8, polynomial 0x31, init 0xFF (SHT3x datasheet, 4.12)
+static uint8_t sht30_crc(const uint8_t* data, size_t length)
+{
+    uint8_t crc = 0xff;
+    for (size_t i = 0; i != length; ++i) {
+        crc ^= data[i];
+        for (int bit = 0; bit != 8; ++bit)
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x31 : crc << 1;
+    }
+    return crc;
+}
+
+
+unsigned long SHT30Sensor::convert()
+{
+    // Single shot, high repeatability, no clock stretching (0x2400),
+    // the bus is free during the measurement (max 15 ms)
+    const uint8_t cmd_lsb = 0x00;
+    m_converting = i2c_bus.write(m_device, 0x24, &cmd_lsb, 1);
+    return m_converting ? 16 : 0;
+}
+
+
+void SHT30Sensor::sample()
 {
-    if (m_sht30.get() != 0) {
-        Serial.println("[SHT30] Error");
+    uint8_t data[6];
+    bool ok = m_converting && i2c_bus.read(m_device, data, sizeof(data))
+           && sht30_crc(data, 2) == data[2] && sht30_crc(data + 3, 2) == data[5];
+    m_converting = false;
+    if (!ok) {
+        LOG_WARN("[SHT30] Error\n");
+        m_temperature = 0.f;
+        m_humidity = 0.f;
+        return;
     }
+    m_temperature = -45.f + 175.f * float(data[0] << 8 | data[1]) / 65535.f;
+    m_humidity = 100.f * float(data[3] << 8 | data[4]) / 65535.f;
 }
 
 
-void SHT30Sensor::output_to_stream(Stream &stream)
+void SHT30Sensor::output_to_stream(Print& stream)
 {
-    stream.print("[SHT30] Temperature: ");
-    stream.print(m_sht30.cTemp);
-    stream.println("°C");
-    stream.print("[SHT30] Humidity: ");
-    stream.print(m_sht30.humidity);
-    stream.println("%");
+    stream.print(F("[SHT30] Temperature: "));
+    stream.print(m_temperature);
+    stream.println(F("°C"));
+    stream.print(F("[SHT30] Humidity: "));
+    stream.print(m_humidity);
+    stream.println(F("%"));
 }
 
 
-void SHT30Sensor::output_to_database(String &query)
+void SHT30Sensor::output_to_database(Print& query)
 {
-    if (m_sht30.cTemp != 0.f) {
-        query.concat("temperature,sensor=SHT30," DEVICE_TAGS " value=");
-        query.concat(m_sht30.cTemp);
-        query.concat('\n');
+    if (m_temperature != 0.f) {
+        query.print(F("temperature,sensor=SHT30," DEVICE_TAGS " value="));
+        query.print(m_temperature);
+        query.print('\n');
     }
 
-    if (m_sht30.humidity != 0.f) {
-        query.concat("humidity,sensor=SHT30," DEVICE_TAGS " value=");
-        query.concat(m_sht30.humidity);
-        query.concat('\n');
+    if (m_humidity != 0.f) {
+        query.print(F("humidity,sensor=SHT30," DEVICE_TAGS " value="));
+        query.print(m_humidity);
+        query.print('\n');
     }
 }
 
 
+void SHT30Sensor::output_values(const ValueCallback& fn)
+{
+    if (m_temperature != 0.f)
+        fn("temperature", "SHT30", m_temperature);
+    if (m_humidity != 0.f)
+        fn("humidity", "SHT30", m_humidity);
+}
+
+
 void SHT30Sensor::output_to_display(Display &display)
 {
 #ifndef WITH_BMP280
-    display.drawValue(1, "%.2f degC", m_sht30.cTemp);
+    display.drawValue(1, PSTR("%.2f degC"), m_temperature);
 #endif
-    display.drawValue(2, "%.2f relH", m_sht30.humidity);
+    display.drawValue(2, PSTR("%.2f relH"), m_humidity);
 }
 
 #endif
@@ -165,7 +263,8 @@ void SHT30Sensor::output_to_display(Display &display)
 
 static BMP280Sensor s_bmp280_sensor;
 
-BMP280Sensor::BMP280Sensor() noexcept
+// I2C, oversampled measurement, the bus is free meanwhile
+BMP280Sensor::BMP280Sensor() noexcept : Sensor(10000)
 {
     Sensor::add(&s_bmp280_sensor);
 }
@@ -173,63 +272,94 @@ BMP280Sensor::BMP280Sensor() noexcept
 
 void BMP280Sensor::setup()
 {
-    if (m_bmp.begin()) {
-        Serial.println("[BMP280] Found.");
+    bool found = i2c_bus.run(m_device, [this] {
+        if (!m_bmp.begin())
+            return false;
         m_bmp.setOversampling(4);
+        return true;
+    });
+    if (found) {
+        LOG_INFO("[BMP280] Found.\n");
     } else {
-        Serial.println("[BMP280] Error.");
+        LOG_WARN("[BMP280] Error.\n");
     }
 }
 
 
-void BMP280Sensor::read()
+unsigned long BMP280Sensor::convert()
 {
-    auto result = m_bmp.startMeasurment();
-    if (result != 0) {
-        delay(result);
+    // returns the measurement time in ms, 0 on error
+    char result = 0;
+    i2c_bus.run(m_device, [this, &result] {
+        result = m_bmp.startMeasurment();
+        return result != 0;
+    });
+    m_converting = result != 0;
+    return (unsigned char) result;
+}
+
+
+void BMP280Sensor::sample()
+{
+    // the bus was free during the measurement
+    if (!m_converting)
+        return;
+    m_converting = false;
+    char result = 0;
+    i2c_bus.run(m_device, [this, &result] {
         result = m_bmp.getTemperatureAndPressure(m_temperature, m_pressure);
+        return result != 0;
+    });
 #ifdef BMP280_TEMP_CORRECTION
-        m_temperature += BMP280_TEMP_CORRECTION;
+    m_temperature += BMP280_TEMP_CORRECTION;
 #endif
-        if (result == 0) {
-            m_temperature = 0;
-            m_pressure = 0;
-        }
+    if (result == 0) {
+        m_temperature = 0;
+        m_pressure = 0;
     }
 }
 
 
-void BMP280Sensor::output_to_stream(Stream &stream)
+void BMP280Sensor::output_to_stream(Print& stream)
 {
-    stream.print("[BMP280] Temperature: ");
+    stream.print(F("[BMP280] Temperature: "));
     stream.print(m_temperature);
-    stream.println("°C");
-    stream.print("[BMP280] Pressure: ");
+    stream.println(F("°C"));
+    stream.print(F("[BMP280] Pressure: "));
     stream.print(m_pressure);
-    stream.println(" hPa");
+    stream.println(F(" hPa"));
 }
 
 
-void BMP280Sensor::output_to_database(String &query)
+void BMP280Sensor::output_to_database(Print& query)
 {
     if (m_temperature != 0) {
-        query.concat("temperature,sensor=BMP280," DEVICE_TAGS " value=");
-        query.concat(m_temperature);
-        query.concat('\n');
+        query.print(F("temperature,sensor=BMP280," DEVICE_TAGS " value="));
+        query.print(m_temperature);
+        query.print('\n');
     }
 
     if (m_pressure != 0) {
-        query.concat("pressure,sensor=BMP280," DEVICE_TAGS " value=");
-        query.concat(m_pressure);
-        query.concat('\n');
+        query.print(F("pressure,sensor=BMP280," DEVICE_TAGS " value="));
+        query.print(m_pressure);
+        query.print('\n');
     }
 }
 
 
+void BMP280Sensor::output_values(const ValueCallback& fn)
+{
+    if (m_temperature != 0)
+        fn("temperature", "BMP280", (float) m_temperature);
+    if (m_pressure != 0)
+        fn("pressure", "BMP280", (float) m_pressure);
+}
+
+
 void BMP280Sensor::output_to_display(Display &display)
 {
-    display.drawValue(1, "%.2f degC", m_temperature);
-    display.drawValue(3, "%.1f hPa", m_pressure);
+    display.drawValue(1, PSTR("%.2f degC"), m_temperature);
+    display.drawValue(3, PSTR("%.1f hPa"), m_pressure);
 }
 
 #endif
@@ -240,7 +370,8 @@ void BMP280Sensor::output_to_display(Display &display)
 
 static MoistSensor s_moist_sensor;
 
-MoistSensor::MoistSensor() noexcept
+// Analog + digital pin, cheap to read
+MoistSensor::MoistSensor() noexcept : Sensor(1000)
 {
     Sensor::add(&s_moist_sensor);
 }
@@ -257,7 +388,7 @@ void MoistSensor::setup()
 }
 
 
-void MoistSensor::read()
+void MoistSensor::sample()
 {
     // Tested values:
     // - emerged in water: 256 (100%)
@@ -269,27 +400,33 @@ void MoistSensor::read()
 }
 
 
-void MoistSensor::output_to_stream(Stream &stream)
+void MoistSensor::output_to_stream(Print& stream)
+{
+    stream.print(F("[soil] Moisture: "));
+    stream.print(m_value);
+    stream.print(F(" (threshold: "));
+    stream.print(m_over_threshold);
+    stream.println(F(")"));
+}
+
+
+void MoistSensor::output_to_database(Print& query)
 {
-    Serial.print("[soil] Moisture: ");
-    Serial.print(m_value);
-    Serial.print(" (threshold: ");
-    Serial.print(m_over_threshold);
-    Serial.println(")");
+    query.print(F("moisture,sensor=Generic," DEVICE_TAGS " value="));
+    query.print(m_value);
+    query.print('\n');
 }
 
 
-void MoistSensor::output_to_database(String &query)
+void MoistSensor::output_values(const ValueCallback& fn)
 {
-    query.concat("moisture,sensor=Generic," DEVICE_TAGS " value=");
-    query.concat(m_value);
-    query.concat('\n');
+    fn("moisture", "Generic", m_value);
 }
 
 
 void MoistSensor::output_to_display(Display &display)
 {
-    display.drawValue(4, "%.1f soilM", m_value);
+    display.drawValue(4, PSTR("%.1f soilM"), m_value);
     if (m_over_threshold) {
         display.drawStar();
     }
@@ -300,3 +437,146 @@ void MoistSensor::output_to_display(Display &display)
 }
 
 #endif
+
+
+#ifdef WITH_HCSR04
+
+
+static HCSR04Sensor s_hcsr04_sensor;
+
+volatile HCSR04Sensor::State HCSR04Sensor::m_state = HCSR04Sensor::State::Idle;
+volatile uint32_t HCSR04Sensor::m_echo_start = 0;
+volatile uint16_t HCSR04Sensor::m_pings[HCSR04_MEDIAN] = {};
+volatile uint8_t HCSR04Sensor::m_next = 0;
+
+// Longest valid echo, us (~4 m, the module gives 38 ms pulse without echo)
+static constexpr uint32_t hcsr04_max_echo = 25000;
+
+// Speed of sound at 20 degC, there and back: 343 m/s / 2 in cm/us
+static constexpr float hcsr04_cm_per_us = 0.01715f;
+
+// The median is updated by interrupts, reading it is cheap
+HCSR04Sensor::HCSR04Sensor() noexcept : Sensor(1000)
+{
+    Sensor::add(&s_hcsr04_sensor);
+}
+
+
+void HCSR04Sensor::setup()
+{
+    pinMode(m_pin_trigger, OUTPUT);
+    digitalWrite(m_pin_trigger, LOW);
+    pinMode(m_pin_echo, INPUT);
+    attachInterrupt(digitalPinToInterrupt(m_pin_echo), on_echo, CHANGE);
+    m_ticker.attach_ms(HCSR04_PING_INTERVAL, ping);
+}
+
+
+void HCSR04Sensor::store(uint32_t echo)
+{
+    m_pings[m_next] = uint16_t(echo);
+    m_next = (m_next + 1) % HCSR04_MEDIAN;
+}
+
+
+void HCSR04Sensor::ping()
+{
+    noInterrupts();
+    // The previous ping got no echo (nothing in range, or a lost edge)
+    if (m_state == State::Triggered || m_state == State::Echo)
+        store(0);
+    m_state = State::Triggered;
+    interrupts();
+
+    digitalWrite(m_pin_trigger, HIGH);
+    delayMicroseconds(10);
+    digitalWrite(m_pin_trigger, LOW);
+}
+
+
+void IRAM_ATTR HCSR04Sensor::on_echo()
+{
+    uint32_t now = micros();
+    if (digitalRead(m_pin_echo) == HIGH) {
+        if (m_state == State::Triggered) {
+            m_echo_start = now;
+            m_state = State::Echo;
+        }
+    } else if (m_state == State::Echo) {
+        uint32_t echo = now - m_echo_start;
+        store(echo <= hcsr04_max_echo ? echo : 0);
+        m_state = State::Done;
+    }
+}
+
+
+void HCSR04Sensor::sample()
+{
+    uint16_t pings[HCSR04_MEDIAN];
+    noInterrupts();
+    for (int i = 0; i != HCSR04_MEDIAN; ++i)
+        pings[i] = m_pings[i];
+    interrupts();
+
+    // Insertion sort of the valid pings, there are only a few
+    uint8_t n = 0;
+    for (uint16_t echo : pings) {
+        if (echo == 0)
+            continue;
+        uint8_t i = n++;
+        for (; i != 0 && pings[i - 1] > echo; --i)
+            pings[i] = pings[i - 1];
+        pings[i] = echo;
+    }
+    m_echoes = n;
+    // Majority of the pings must agree, otherwise report no value
+    if (n <= HCSR04_MEDIAN / 2) {
+        m_distance = 0.f;
+        return;
+    }
+    m_distance = pings[n / 2] * hcsr04_cm_per_us;
+}
+
+
+void HCSR04Sensor::output_to_stream(Print& stream)
+{
+    stream.print(F("[HC-SR04] Distance: "));
+    stream.print(m_distance);
+    stream.print(F(" cm ("));
+    stream.print(m_echoes);
+    stream.println(F(" echoes)"));
+}
+
+
+void HCSR04Sensor::output_to_database(Print& query)
+{
+    if (m_distance == 0.f)
+        return;
+    query.print(F("distance,sensor=HCSR04," DEVICE_TAGS " value="));
+    query.print(m_distance);
+    query.print('\n');
+#ifdef HCSR04_TANK_DEPTH
+    query.print(F("level,sensor=HCSR04," DEVICE_TAGS " value="));
+    query.print(HCSR04_TANK_DEPTH - m_distance);
+    query.print('\n');
+#endif
+}
+
+
+void HCSR04Sensor::output_values(const ValueCallback& fn)
+{
+    if (m_distance == 0.f)
+        return;
+    fn("distance", "HCSR04", m_distance);
+#ifdef HCSR04_TANK_DEPTH
+    fn("level", "HCSR04", HCSR04_TANK_DEPTH - m_distance);
+#endif
+}
+
+
+void HCSR04Sensor::output_to_display(Display& display)
+{
+    display.drawValue(4, PSTR("%.1f cm"), m_distance);
+}
+
+#endif
@@ -4,22 +4,24 @@
 #define GADGETS_SENSOR_H
 
 #include "Display.h"
+#include "I2CBus.h"
 
 #ifdef WITH_DALLAS_TEMP
 #include <OneWire.h>
 #include <DallasTemperature.h>
 #endif
 
-#ifdef WITH_SHT30
-#include <WEMOS_SHT3X.h>
-#endif
-
 #ifdef WITH_BMP280
-#include <Wire.h>
 #include <BMP280.h>
 #endif
 
-#include <Stream.h>
+#ifdef WITH_HCSR04
+#include <Ticker.h>
+#endif
+
+#include <Arduino.h>
+#include <Print.h>
+#include <functional>
 
 
 class Sensor {
@@ -29,25 +31,56 @@ public:
     // initial setup
     virtual void setup() = 0;
 
-    // read the sensor value
-    virtual void read() = 0;
+    // read the sensor value, unless the cached one is younger than `period()`
+    // - returns age of the value in ms (0 = just read)
+    // - call this as often as needed, the sensor decides about bus traffic
+    // - same as `start()` + `finish()`, waits for the conversion
+    unsigned long read();
+
+    // split read, to do something else while the sensor converts
+    // - `start()` begins the conversion, unless the cached value is younger
+    //   than `period()` - returns false then, there is nothing to finish
+    // - `finish()` waits for the rest of the conversion and reads the value
+    bool start();
+    void finish();
+
+    // started, not finished yet
+    bool pending() const { return m_pending; }
+
+    // minimum sampling period in ms (0 = no cache, read each time)
+    unsigned long period() const { return m_period; }
+
+    // the cached value exists (`read()` was called at least once)
+    bool sampled() const { return m_sampled; }
+
+    // age of the cached value in ms, without reading the sensor
+    unsigned long age() const { return millis() - m_sample_time; }
 
     // print the value into stream
-    // - usage: `print_value(Serial)`
+    // - usage: `output_to_stream(logger)`
     // - should print descriptive text: `[LDR] value: 956`
     // - this method should append one or more lines (do not forget newlines)
-    virtual void output_to_stream(Stream& stream) = 0;
+    virtual void output_to_stream(Print& stream) = 0;
 
-    // print the value into database query string
+    // print the value into database query (InfluxDB line protocol)
     // - the format is: "<field>,<tags> value=<value>"
     // - for example: "temperature," DEVICE_TAGS " value=21.3\n"
-    // - this method should append one or more lines (do not forget newlines)
-    // - do not replace existing content!
-    virtual void output_to_database(String& query) = 0;
+    // - keep the constant part in flash: `query.print(F("temperature," DEVICE_TAGS " value="))`
+    // - this method should append one or more lines (do not forget newlines,
+    //   but don't use println, it appends "\r\n")
+    // - the query is usually Arena::Writer, the method must not allocate
+    virtual void output_to_database(Print& query) = 0;
 
     // print the value to the display
     virtual void output_to_display(Display& display) {}
 
+    // pass each value to `fn(measurement, sensor, value)`
+    // - measurement and sensor are the names used in database query:
+    //   `fn("temperature", "SHT30", 21.3f)`
+    // - skip values which are not sent to database
+    using ValueCallback = std::function<void(const char* measurement, const char* sensor, float value)>;
+    virtual void output_values(const ValueCallback& fn) = 0;
+
     // INSTANCE REGISTRY
 
     template <typename F>
@@ -60,12 +93,28 @@ public:
     }
 
 protected:
+    explicit Sensor(unsigned long period) : m_period(period) {}
+
+    // start the measurement in hardware, called by `start()`
+    // - returns time in ms until `sample()` can read the result
+    // - sensors which read everything at once do it in `sample()`
+    virtual unsigned long convert() { return 0; }
+
+    // read the value from hardware, called by `finish()`
+    virtual void sample() = 0;
+
     static void add(Sensor* sensor) {
         sensor->m_next = m_first;
         m_first = sensor;
     }
 
 private:
+    const unsigned long m_period;
+    unsigned long m_sample_time = 0;  // millis() of last start()
+    unsigned long m_conversion = 0;   // ms, returned by convert()
+    bool m_sampled = false;
+    bool m_pending = false;
+
     Sensor* m_next = nullptr;
     static Sensor* m_first;
 };
@@ -77,11 +126,13 @@ class LDRSensor final: public Sensor {
 public:
     LDRSensor() noexcept;
     void setup() override { pinMode(m_pin, INPUT); }
-    void read() override { m_value = analogRead(m_pin); }
-    void output_to_stream(Stream& stream) override;
-    void output_to_database(String& query) override;
+    void output_to_stream(Print& stream) override;
+    void output_to_database(Print& query) override;
+    void output_values(const ValueCallback& fn) override;
 
 private:
+    void sample() override { m_value = analogRead(m_pin); }
+
     static constexpr int m_pin = A0;
     int m_value = 0;
 };
@@ -94,11 +145,14 @@ class DallasTempSensor final: public Sensor {
 public:
     DallasTempSensor() noexcept;
     void setup() override;
-    void read() override;
-    void output_to_stream(Stream& stream) override;
-    void output_to_database(String& query) override;
+    void output_to_stream(Print& stream) override;
+    void output_to_database(Print& query) override;
+    void output_values(const ValueCallback& fn) override;
 
 private:
+    unsigned long convert() override;
+    void sample() override;
+
     static constexpr int m_pin = D2;  // GPIO4
     OneWire m_wire {m_pin};
     DeviceAddress m_addr;
@@ -114,13 +168,19 @@ class SHT30Sensor final: public Sensor {
 public:
     SHT30Sensor() noexcept;
     void setup() override {}
-    void read() override;
-    void output_to_stream(Stream& stream) override;
-    void output_to_database(String& query) override;
+    void output_to_stream(Print& stream) override;
+    void output_to_database(Print& query) override;
+    void output_values(const ValueCallback& fn) override;
     void output_to_display(Display& display) override;
 
 private:
-    SHT3X m_sht30;
+    unsigned long convert() override;
+    void sample() override;
+
+    I2CBus::Device m_device {"SHT30", 0x45, 1000000};
+    float m_temperature = 0.f;
+    float m_humidity = 0.f;
+    bool m_converting = false;  // the measurement command was accepted
 };
 #endif
 
@@ -131,15 +191,20 @@ class BMP280Sensor final: public Sensor {
 public:
     BMP280Sensor() noexcept;
     void setup() override;
-    void read() override;
-    void output_to_stream(Stream& stream) override;
-    void output_to_database(String& query) override;
+    void output_to_stream(Print& stream) override;
+    void output_to_database(Print& query) override;
+    void output_values(const ValueCallback& fn) override;
     void output_to_display(Display& display) override;
 
 private:
+    unsigned long convert() override;
+    void sample() override;
+
     BMP280 m_bmp;
+    I2CBus::Device m_device {"BMP280", 0x77, 400000};
     double m_temperature = 0;
     double m_pressure = 0;
+    bool m_converting = false;  // the measurement was started
 };
 #endif
 
@@ -150,12 +215,14 @@ class MoistSensor final: public Sensor {
 public:
     MoistSensor() noexcept;
     void setup() override;
-    void read() override;
-    void output_to_stream(Stream& stream) override;
-    void output_to_database(String& query) override;
+    void output_to_stream(Print& stream) override;
+    void output_to_database(Print& query) override;
+    void output_values(const ValueCallback& fn) override;
     void output_to_display(Display& display) override;
 
 private:
+    void sample() override;
+
     static constexpr int m_pin = A0;
     static constexpr int m_pin_digi = D3;
     float m_value = 0.f;
@@ -163,4 +230,56 @@ private:
 };
 #endif
 
+
+#ifdef WITH_HCSR04
+// Time between pings, ms. The echo of a far wall can come back
+// after ~25 ms, the datasheet recommends 60 ms between pings.
+#ifndef HCSR04_PING_INTERVAL
+#define HCSR04_PING_INTERVAL 100
+#endif
+
+// Number of pings in the median filter (odd)
+#ifndef HCSR04_MEDIAN
+#define HCSR04_MEDIAN 5
+#endif
+
+// HC-SR04 ultrasonic distance sensor (water tank level)
+// - pings are triggered by a timer, the echo pulse is timed
+//   by pin-change interrupt - no waiting in loop()
+// - `sample()` only takes the median of the last HCSR04_MEDIAN pings
+// - Echo output is 5 V, connect it through a divider (e.g. 1k / 2k)
+class HCSR04Sensor final: public Sensor {
+public:
+    HCSR04Sensor() noexcept;
+    void setup() override;
+    void output_to_stream(Print& stream) override;
+    void output_to_database(Print& query) override;
+    void output_values(const ValueCallback& fn) override;
+    void output_to_display(Display& display) override;
+
+private:
+    void sample() override;
+
+    // timer callback, sends the trigger pulse
+    static void ping();
+    // interrupt handler, measures the echo pulse
+    static void IRAM_ATTR on_echo();
+    // record one ping (echo length in us, 0 = no echo)
+    static void IRAM_ATTR store(uint32_t echo);
+
+    static constexpr int m_pin_trigger = D5;  // GPIO14
+    static constexpr int m_pin_echo = D7;     // GPIO13
+    Ticker m_ticker;
+    float m_distance = 0.f;  // cm, 0 = no valid echo
+    uint8_t m_echoes = 0;    // valid pings in the median
+
+    // shared with the interrupt handler
+    enum class State: uint8_t { Idle, Triggered, Echo, Done };
+    static volatile State m_state;
+    static volatile uint32_t m_echo_start;                 // micros()
+    static volatile uint16_t m_pings[HCSR04_MEDIAN];       // echo length, us
+    static volatile uint8_t m_next;
+};
+#endif
+
 #endif // GADGETS_SENSOR_H
@@ -7,8 +7,13 @@ void Sweeper::setup()
 
 {
     pinMode(m_pin_button, INPUT);
-    m_servo.attach(m_pin_servo);
-    m_servo.write(m_home_pos);
+    if (m_pin_power != -1)
+        pinMode(m_pin_power, OUTPUT);
+    m_pos = m_home_pos;
+    // Move to home pos, then power off
+    power_on();
+    m_hold_start = millis();
+    m_state = State::Settle;
 }
 
 
@@ -18,20 +23,119 @@ bool Sweeper::check_button()
     int buttonState = digitalRead(m_pin_button);
     // print out the state of the button:
     if (buttonState) {
-        Serial.println("[sweeper btn pressed]");
+        Serial.println(F("[sweeper btn pressed]"));
     }
     return buttonState;
 }
 
 
-void Sweeper::sweep()
+void Sweeper::sweep(int count)
+{
+    if (count <= 0)
+        return;
+    m_queued += count;
+}
+
+
+void Sweeper::update()
+{
+    auto now = millis();
+    // Limit the time step, so a stalled main loop doesn't make the servo jump
+    float dt = min((now - m_last_update) / 1000.f, 0.05f);
+    m_last_update = now;
+
+    switch (m_state) {
+        case State::Idle:
+            if (m_queued == 0)
+                return;
+            power_on();
+            // fall through
+
+        case State::Settle:
+            if (m_queued > 0) {
+                --m_queued;
+                Serial.println(F("* Sweep started"));
+                m_vel = 0.f;
+                m_state = State::Out;
+            } else if (now - m_hold_start >= (unsigned long) m_settle_time) {
+                power_off();
+                m_state = State::Idle;
+            }
+            break;
+
+        case State::Out:
+            if (move(m_sweep_pos, dt)) {
+                m_hold_start = now;
+                m_state = State::Hold;
+            }
+            break;
+
+        case State::Hold:
+            if (now - m_hold_start >= (unsigned long) m_hold_time)
+                m_state = State::Back;
+            break;
+
+        case State::Back:
+            if (move(m_home_pos, dt)) {
+                Serial.println(F("* Sweep complete"));
+                m_hold_start = now;
+                m_state = State::Settle;
+            }
+            break;
+    }
+}
+
+
+bool Sweeper::move(float target, float dt)
 {
-    Serial.println("* Sweep started");
+    float dist = fabsf(target - m_pos);
 
-    m_servo.write(m_sweep_pos);
-    delay(m_sweep_delay);
-    m_servo.write(m_home_pos);
-    delay(m_sweep_delay);
+    // Trapezoidal profile: brake when the stopping distance reaches
+    // the remaining distance, otherwise accelerate up to max speed
+    if (m_vel * m_vel / (2.f * m_accel) >= dist)
+        m_vel = max(m_vel - m_accel * dt, 0.f);
+    else
+        m_vel = min(m_vel + m_accel * dt, m_speed);
 
-    Serial.println("* Sweep complete");
+    float step = m_vel * dt;
+    if (step >= dist || (m_vel == 0.f && dist < 1.f)) {
+        m_pos = target;
+        m_vel = 0.f;
+        write_pos();
+        return true;
+    }
+
+    m_pos += (target > m_pos) ? step : -step;
+    write_pos();
+    return false;
+}
+
+
+void Sweeper::write_pos()
+{
+    int pos = (int) lroundf(m_pos);
+    if (pos != m_written_pos) {
+        m_servo.write(pos);
+        m_written_pos = pos;
+    }
+}
+
+
+void Sweeper::power_on()
+{
+    if (m_pin_power != -1)
+        digitalWrite(m_pin_power, HIGH);
+    m_servo.attach(m_pin_servo);
+    m_written_pos = -1;
+    write_pos();
+}
+
+
+void Sweeper::power_off()
+{
+    // Without the control pulses, the servo doesn't hold the position
+    // and draws only quiescent current (or nothing with power pin)
+    m_servo.detach();
+    if (m_pin_power != -1)
+        digitalWrite(m_pin_power, LOW);
 }
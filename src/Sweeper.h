@@ -7,23 +7,66 @@
 
 class Sweeper {
 public:
-    Sweeper(int pin_servo, int pin_button) noexcept
-        : m_pin_servo(pin_servo), m_pin_button(pin_button) {}
+    // `pin_power` (optional) switches the servo supply, HIGH = on
+    Sweeper(int pin_servo, int pin_button, int pin_power = -1) noexcept
+        : m_pin_servo(pin_servo), m_pin_button(pin_button), m_pin_power(pin_power) {}
 
     void setup();
 
     bool check_button();
-    void sweep();
+
+    // Queue `count` sweeps (home -> sweep pos -> home), don't wait for them.
+    // `count` <= 0 is ignored.
+    void sweep(int count = 1);
+
+    // Move the servo, call this often (every few ms) from the main loop
+    void update();
+
+    // Sweep in progress or queued, servo is powered
+    bool busy() const { return m_state != State::Idle || m_queued > 0; }
+
+    int button_pin() const { return m_pin_button; }
+
+    // Motion profile: max speed [deg/s], acceleration [deg/s^2]
+    void set_profile(float speed, float accel) { m_speed = speed; m_accel = accel; }
+
+private:
+    enum class State {
+        Idle,
+        Out,        // moving to sweep pos
+        Hold,       // waiting in sweep pos
+        Back,       // returning to home pos
+        Settle,     // let the servo reach the position, then power it off
+    };
+
+    // Advance towards `target`, returns true when reached
+    bool move(float target, float dt);
+    void write_pos();
+    void power_on();
+    void power_off();
 
 private:
     Servo m_servo;
 
     int m_pin_servo;
     int m_pin_button;
+    int m_pin_power;
 
     int m_home_pos = 160;    // start in this pos and return here after sweep
     int m_sweep_pos = 0;
-    int m_sweep_delay = 500;
+    int m_hold_time = 100;   // ms in sweep pos
+    int m_settle_time = 300; // ms in home pos before powering off
+
+    float m_speed = 360.f;   // deg/s
+    float m_accel = 2000.f;  // deg/s^2
+
+    State m_state = State::Idle;
+    int m_queued = 0;
+    float m_pos = 0.f;       // deg
+    float m_vel = 0.f;       // deg/s, always >= 0 (towards target)
+    int m_written_pos = -1;
+    unsigned long m_last_update = 0;   // ms
+    unsigned long m_hold_start = 0;    // ms, also used for Settle
 };
 
 #endif // include guard
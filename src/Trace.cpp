@@ -0,0 +1,326 @@
+// Trace.cpp - created by Radek Brich on 2026-10-19
+
+#ifdef WITH_TRACE
+
+#include "Trace.h"
+#include "HeapCheck.h"
+#include <string.h>
+
+namespace trace {
+
+static constexpr uint32_t mask = TRACE_BUFFER_SIZE - 1;
+static_assert((TRACE_BUFFER_SIZE & mask) == 0, "TRACE_BUFFER_SIZE must be a power of two");
+
+// Longest record: Send / Receive chunk, or Name
+static constexpr size_t max_chunk = 128;
+static constexpr size_t max_name = 32;
+static constexpr size_t max_record = 1 + 5 + 2 + max_chunk;
+
+static constexpr uint8_t max_series = 16;
+
+
+// One record, encoded on stack before it goes to the ring buffer
+class Encoder {
+public:
+    void byte(uint8_t b) { m_data[m_len++] = b; }
+
+    void varint(uint32_t v) {
+        while (v >= 0x80) {
+            byte(uint8_t(v) | 0x80);
+            v >>= 7;
+        }
+        byte(uint8_t(v));
+    }
+
+    void bytes(const uint8_t* data, size_t length) {
+        memcpy(m_data + m_len, data, length);
+        m_len += length;
+    }
+
+    void string(const char* str) {
+        size_t len = strnlen(str, max_name);
+        bytes((const uint8_t*) str, len);
+        byte(0);
+    }
+
+    const uint8_t* data() const { return m_data; }
+    size_t length() const { return m_len; }
+
+private:
+    uint8_t m_data[max_record];
+    size_t m_len = 0;
+};
+
+
+namespace {
+
+struct Recorder {
+    bool active = false;
+    Print* sink = nullptr;
+
+    uint8_t buffer[TRACE_BUFFER_SIZE];
+    uint32_t head = 0;      // total bytes written (wraps)
+    uint32_t tail = 0;      // total bytes sent to the collector
+    uint32_t dropped = 0;   // records not written since the last Dropped
+    unsigned long last_time = 0;
+
+    struct Series {
+        const char* measurement;
+        const char* sensor;
+    };
+    Series series[max_series];
+    uint8_t n_series = 0;
+    int8_t wifi = -1;       // last recorded state, -1 = none yet
+    bool open = false;      // connection open, Closed not recorded yet
+
+    // Bytes are read one by one, consecutive ones go into one record
+    uint8_t rx[max_chunk];
+    size_t rx_len = 0;
+    unsigned long rx_time = 0;
+
+#ifndef SIM_HOST
+    WiFiServer server {TRACE_PORT};
+    WiFiClient client;
+#endif
+
+    void start(Encoder& rec, Record type, unsigned long time);
+    void commit(const Encoder& rec);
+    void flush_rx();
+    void drain(size_t room);
+};
+
+} // namespace
+
+
+#ifdef SIM_HOST
+static thread_local Recorder recorder;
+#else
+static Recorder recorder;
+#endif
+
+
+void Recorder::start(Encoder& rec, Record type, unsigned long time)
+{
+    rec.byte(uint8_t(type));
+    // Connect is recorded after it returns, with its start time
+    rec.varint(time > last_time ? time - last_time : 0);
+    if (time > last_time)
+        last_time = time;
+}
+
+
+void Recorder::commit(const Encoder& rec)
+{
+    if (dropped != 0) {
+        // Replay stops at this record, it can't know what was lost
+        Encoder drop;
+        start(drop, Record::Dropped, last_time);
+        drop.varint(dropped);
+        if (head - tail + drop.length() + rec.length() > TRACE_BUFFER_SIZE) {
+            ++dropped;
+            return;
+        }
+        dropped = 0;
+        commit(drop);
+    }
+    if (head - tail + rec.length() > TRACE_BUFFER_SIZE) {
+        ++dropped;
+        return;
+    }
+    for (size_t i = 0; i != rec.length(); ++i)
+        buffer[head++ & mask] = rec.data()[i];
+}
+
+
+void Recorder::flush_rx()
+{
+    if (rx_len == 0)
+        return;
+    Encoder rec;
+    start(rec, Record::Receive, rx_time);
+    rec.varint(rx_len);
+    rec.bytes(rx, rx_len);
+    rx_len = 0;
+    commit(rec);
+}
+
+
+void Recorder::drain(size_t room)
+{
+    while (room != 0 && tail != head) {
+        // contiguous part up to the end of the buffer
+        size_t begin = tail & mask;
+        size_t len = min(size_t(head - tail), TRACE_BUFFER_SIZE - begin);
+        len = sink->write(&buffer[begin], min(len, room));
+        if (len == 0)
+            break;
+        tail += len;
+        room -= len;
+    }
+}
+
+
+void begin()
+{
+#ifndef SIM_HOST
+    recorder.server.begin();
+    recorder.server.setNoDelay(true);
+    recorder.active = true;
+#else
+    recorder.active = recorder.sink != nullptr;
+#endif
+    if (!recorder.active)
+        return;
+    for (char c : magic)
+        recorder.buffer[recorder.head++ & mask] = uint8_t(c);
+}
+
+
+void loop()
+{
+    if (!recorder.active)
+        return;
+    if (millis() != recorder.rx_time)
+        recorder.flush_rx();
+
+#ifndef SIM_HOST
+    // The first client gets the trace from the beginning,
+    // a later one only continues it
+    heap_check::Pause pause;
+    if (!recorder.client.connected() && recorder.server.hasClient()) {
+        recorder.client = recorder.server.available();
+        recorder.sink = &recorder.client;
+    }
+    if (recorder.sink == nullptr || !recorder.client.connected())
+        return;
+#endif
+    int room = recorder.sink->availableForWrite();
+    if (room > 0)
+        recorder.drain(room);
+}
+
+
+void flush()
+{
+    if (!recorder.active || recorder.sink == nullptr)
+        return;
+    recorder.flush_rx();
+    recorder.drain(TRACE_BUFFER_SIZE);
+    recorder.sink->flush();
+}
+
+
+void set_sink(Print* sink)
+{
+    recorder.sink = sink;
+}
+
+
+void sensor(const char* measurement, const char* sensor, float value)
+{
+    if (!recorder.active)
+        return;
+    recorder.flush_rx();
+    unsigned long now = millis();
+
+    uint8_t id = 0;
+    while (id != recorder.n_series && (strcmp(recorder.series[id].measurement, measurement) != 0
+                                    || strcmp(recorder.series[id].sensor, sensor) != 0))
+        ++id;
+    if (id == max_series)
+        return;
+    if (id == recorder.n_series) {
+        recorder.series[id] = {measurement, sensor};
+        ++recorder.n_series;
+        Encoder rec;
+        recorder.start(rec, Record::Name, now);
+        rec.byte(id);
+        rec.string(measurement);
+        rec.string(sensor);
+        recorder.commit(rec);
+    }
+
+    Encoder rec;
+    recorder.start(rec, Record::Sensor, now);
+    rec.byte(id);
+    uint8_t raw[4];
+    memcpy(raw, &value, sizeof(raw));  // both ESP8266 and x86 are little endian
+    rec.bytes(raw, sizeof(raw));
+    recorder.commit(rec);
+}
+
+
+void connect(bool ok, unsigned long duration)
+{
+    if (!recorder.active)
+        return;
+    recorder.flush_rx();
+    Encoder rec;
+    recorder.open = ok;
+    recorder.start(rec, Record::Connect, millis() - duration);
+    rec.byte(ok);
+    rec.varint(duration);
+    recorder.commit(rec);
+}
+
+
+void send(const uint8_t* data, size_t length)
+{
+    if (!recorder.active)
+        return;
+    recorder.flush_rx();
+    unsigned long now = millis();
+    while (length != 0) {
+        size_t chunk = min(length, max_chunk);
+        Encoder rec;
+        recorder.start(rec, Record::Send, now);
+        rec.varint(chunk);
+        rec.bytes(data, chunk);
+        recorder.commit(rec);
+        data += chunk;
+        length -= chunk;
+    }
+}
+
+
+void receive(uint8_t c)
+{
+    if (!recorder.active)
+        return;
+    unsigned long now = millis();
+    if (recorder.rx_len == max_chunk || (recorder.rx_len != 0 && now != recorder.rx_time))
+        recorder.flush_rx();
+    if (recorder.rx_len == 0)
+        recorder.rx_time = now;
+    recorder.rx[recorder.rx_len++] = c;
+}
+
+
+void closed()
+{
+    if (!recorder.active || !recorder.open)
+        return;
+    recorder.open = false;
+    recorder.flush_rx();
+    Encoder rec;
+    recorder.start(rec, Record::Closed, millis());
+    recorder.commit(rec);
+}
+
+
+bool wifi(bool connected)
+{
+    if (!recorder.active || recorder.wifi == int8_t(connected))
+        return connected;
+    recorder.flush_rx();
+    recorder.wifi = int8_t(connected);
+    Encoder rec;
+    recorder.start(rec, Record::Wifi, millis());
+    rec.byte(connected);
+    recorder.commit(rec);
+    return connected;
+}
+
+} // namespace trace
+
+#endif
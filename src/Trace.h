@@ -0,0 +1,97 @@
+// Trace.h - created by Radek Brich on 2026-10-19
+
+#ifndef GADGETS_TRACE_H
+#define GADGETS_TRACE_H
+
+#include <Arduino.h>
+#include <Print.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(WITH_TRACE) && !defined(SIM_HOST)
+#include <ESP8266WiFi.h>
+#endif
+
+// TCP port for the trace collector: nc <device> 2324 > session.trace
+#ifndef TRACE_PORT
+#define TRACE_PORT 2324
+#endif
+
+// Must be a power of two
+#ifndef TRACE_BUFFER_SIZE
+#define TRACE_BUFFER_SIZE 4096
+#endif
+
+// Session recording for deterministic replay (-DWITH_TRACE).
+//
+// Records what the firmware observed from the outside world: sensor values,
+// Wi-Fi state, the data received from servers (with timing) and millis()
+// of each event. The fleet simulator replays a trace through the real
+// sensors.cpp and HttpClient code, see `fleet_sim --replay`.
+//
+// Records are encoded into a RAM ring buffer, `loop()` drains it to the
+// collector (the first client of TRACE_PORT on device, a file in the simulator).
+// The trace starts at boot, so connect the collector soon: when the buffer
+// is full, new records are dropped (and counted) - the trace can't be replayed
+// past that point.
+//
+// Without WITH_TRACE, all functions are empty inlines.
+namespace trace {
+
+// Trace format: magic, then records
+//   <type:1> <dt:varint> <payload>
+// dt is ms since the previous record (the first one: since boot),
+// varint is unsigned LEB128, float is IEEE 754 little endian.
+constexpr char magic[4] = {'G', 'T', 'R', '1'};
+
+enum class Record: uint8_t {
+    Name = 'N',     // <id:1> <measurement> \0 <sensor> \0 - before first Sensor with the id
+    Sensor = 'S',   // <id:1> <value:float> - new sample
+    Wifi = 'F',     // <connected:1> - result of WiFi.isConnected(), on change
+    Connect = 'C',  // <ok:1> <duration:varint> - TCP connect (dt is its start)
+    Send = 'W',     // <length:varint> <data> - written to the connection
+    Receive = 'R',  // <length:varint> <data> - read from the connection
+    Closed = 'X',   // connection closed by the server
+    Dropped = 'D',  // <count:varint> - records lost due to full buffer
+};
+
+#ifdef WITH_TRACE
+
+// Start recording (device: listen on TRACE_PORT)
+void begin();
+
+// Send buffered records to the collector, without blocking
+void loop();
+
+// Send everything, blocking (end of simulation)
+void flush();
+
+// Collector in the simulator (set before `begin()`, otherwise nothing is recorded)
+void set_sink(Print* sink);
+
+// Events - call these where the firmware observes them
+void sensor(const char* measurement, const char* sensor, float value);
+void connect(bool ok, unsigned long duration);
+void send(const uint8_t* data, size_t length);
+void receive(uint8_t c);
+void closed();
+bool wifi(bool connected);  // returns `connected`
+
+#else
+
+inline void begin() {}
+inline void loop() {}
+inline void flush() {}
+inline void set_sink(Print*) {}
+inline void sensor(const char*, const char*, float) {}
+inline void connect(bool, unsigned long) {}
+inline void send(const uint8_t*, size_t) {}
+inline void receive(uint8_t) {}
+inline void closed() {}
+inline bool wifi(bool connected) { return connected; }
+
+#endif
+
+} // namespace trace
+
+#endif // include guard
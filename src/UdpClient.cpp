@@ -0,0 +1,82 @@
+// UdpClient.cpp - created by Radek Brich on 2026-10-19
+
+#include "UdpClient.h"
+#include "HeapCheck.h"
+#include "Log.h"
+
+
+bool UdpClient::resolve(const char* host)
+{
+    // Resolve once, then reuse the address for following reports
+    if (m_addr.isSet())
+        return true;
+    heap_check::Pause pause;
+    if (!WiFi.hostByName(host, m_addr)) {
+        LOG_WARN("* Cannot resolve %s\n", host);
+        m_addr = IPAddress();
+        return false;
+    }
+    LOG_INFO("* Resolved %s (%u.%u.%u.%u)\n", host, m_addr[0], m_addr[1], m_addr[2], m_addr[3]);
+    return true;
+}
+
+
+bool UdpClient::send_packet(const char* data, size_t len, uint16_t port)
+{
+    heap_check::Pause pause;
+    if (!m_udp.beginPacket(m_addr, port))
+        return false;
+    m_udp.write((const uint8_t*) data, len);
+    return m_udp.endPacket() != 0;
+}
+
+
+int UdpClient::send(const char* host, uint16_t port, const char* data, size_t length)
+{
+    m_display.drawText(2, F("Send "));
+    m_display.display();
+
+    if (!resolve(host)) {
+        m_display.appendText(F("FAIL"));
+        m_display.display();
+        return -1;
+    }
+
+    // Pack whole lines into datagrams, split only at line boundaries.
+    // A single line longer than `max_payload` is sent alone (IP fragmented).
+    const char* packet = data;  // start of current datagram
+    const char* end = data + length;
+    const char* cut = packet;  // end of complete lines in current datagram
+    int packets = 0;
+    bool ok = true;
+    while (ok && cut < end) {
+        auto nl = (const char*) memchr(cut, '\n', end - cut);
+        const char* line_end = nl ? nl + 1 : end;
+        if (size_t(line_end - packet) > max_payload && cut != packet) {
+            // The line doesn't fit, flush the datagram first
+            ok = send_packet(packet, cut - packet, port);
+            ++packets;
+            packet = cut;
+        } else
+            cut = line_end;
+    }
+    if (ok && cut != packet) {
+        ok = send_packet(packet, cut - packet, port);
+        ++packets;
+    }
+
+    if (!ok) {
+        LOG_WARN("* UDP send failed.\n");
+        // Resolve again next time, the server may have moved
+        m_addr = IPAddress();
+        m_display.appendText(F("FAIL"));
+        m_display.display();
+        return -1;
+    }
+
+    LOG_INFO("* Sent %u bytes in %d datagram(s) to %s:%u\n",
+             (unsigned) length, packets, host, port);
+    m_display.appendText(F("OK"));
+    m_display.display();
+    return packets;
+}
@@ -0,0 +1,34 @@
+// UdpClient.h - created by Radek Brich on 2026-10-19
+
+#ifndef GADGETS_UDPCLIENT_H
+#define GADGETS_UDPCLIENT_H
+
+#include "Display.h"
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+
+// Fire-and-forget sender for InfluxDB UDP line-protocol listener.
+// Lines are packed into datagrams which fit into one Ethernet frame,
+// nothing is waited for and lost datagrams are not retransmitted.
+class UdpClient {
+public:
+    // 1500 (Ethernet MTU) - 20 (IPv4 header) - 8 (UDP header)
+    static constexpr size_t max_payload = 1472;
+
+    explicit UdpClient(Display& display) : m_display(display) {}
+
+    // Send `data` (one or more lines, each terminated by '\n')
+    // Returns number of datagrams sent, or -1 on error.
+    int send(const char* host, uint16_t port, const char* data, size_t length);
+
+private:
+    bool resolve(const char* host);
+    bool send_packet(const char* data, size_t len, uint16_t port);
+
+private:
+    WiFiUDP m_udp;
+    Display& m_display;
+    IPAddress m_addr;
+};
+
+#endif // include guard
@@ -1,37 +1,107 @@
 // fish_feeder.cpp - created by Radek Brich on 2019-09-14
 
+// The MCU sleeps in power-down mode until the button is pressed.
+// The button (pin 2 = INT1) wakes it up with an external interrupt.
+// The servo is powered only during the sweep.
+
 #include "Sweeper.h"
 #include <Arduino.h>
+#include <avr/sleep.h>
+#include <avr/power.h>
+
+#ifndef SERVO_POWER_PIN
+#define SERVO_POWER_PIN -1
+#endif
+
+static Sweeper sweeper(9, 2, SERVO_POWER_PIN);
+
+static constexpr unsigned long debounce_ms = 30;
+
+static volatile bool button_edge = false;
+static bool debouncing = false;
+static unsigned long press_time = 0;
+
 
-static Sweeper sweeper(9, 2);
+static void on_button()
+{
+    button_edge = true;
+}
+
+
+// USB host is connected - don't power down, that would drop the serial console
+static bool usb_powered()
+{
+    return USBSTA & _BV(VBUS);
+}
+
+
+static void sleep(uint8_t mode)
+{
+    set_sleep_mode(mode);
+    noInterrupts();
+    // Check with interrupts disabled, so the edge cannot be missed
+    if (button_edge) {
+        interrupts();
+        return;
+    }
+    sleep_enable();
+    interrupts();  // the next instruction is executed before any interrupt
+    sleep_cpu();
+    sleep_disable();
+}
 
 
 void setup()
 {
     // Connect with: pio device monitor
+    // (don't wait for it when running from battery)
     Serial.begin(57600);
-    while (!Serial)
+    while (!Serial && usb_powered() && millis() < 3000)
         ;
     Serial.println();
-    Serial.println("=== Setup ===");
+    Serial.println(F("=== Setup ==="));
 
     // LED pins
     pinMode(LED_BUILTIN, OUTPUT);
 
+    // ADC is not used
+    ADCSRA &= ~_BV(ADEN);
+    power_adc_disable();
+
     sweeper.setup();
+    attachInterrupt(digitalPinToInterrupt(sweeper.button_pin()), on_button, RISING);
 
-    Serial.println("=== Loop ===");
+    Serial.println(F("=== Loop ==="));
 }
 
 
 void loop()
 {
-    // Reset LEDs
-    digitalWrite(LED_BUILTIN, HIGH);
-    delay(200);
+    if (button_edge) {
+        button_edge = false;
+        if (!debouncing) {
+            debouncing = true;
+            press_time = millis();
+        }
+    }
+
+    // Accept the press if the button is still held after debounce time
+    if (debouncing && millis() - press_time >= debounce_ms) {
+        debouncing = false;
+        if (sweeper.check_button())
+            sweeper.sweep();
+    }
+
+    sweeper.update();
+
+    // LED is on while sweeping
+    digitalWrite(LED_BUILTIN, sweeper.busy() ? HIGH : LOW);
 
-    if (sweeper.check_button()) {
-        digitalWrite(LED_BUILTIN, LOW);
-        sweeper.sweep();
+    if (sweeper.busy() || debouncing || usb_powered()) {
+        // Timer0 interrupt wakes us up again in 1 ms
+        sleep(SLEEP_MODE_IDLE);
+    } else {
+        Serial.flush();
+        sleep(SLEEP_MODE_PWR_DOWN);
     }
 }
@@ -5,9 +5,31 @@
 #include "Display.h"
 #include "Sensor.h"
 #include "HttpClient.h"
+#include "AdaptiveInterval.h"
+#include "AlertRules.h"
+#include "Arena.h"
+#include "HeapCheck.h"
+#include "I2CBus.h"
+#include "Log.h"
+#include "Trace.h"
+
+#ifdef WITH_UDP_TRANSPORT
+#include "UdpClient.h"
+#endif
+
+#ifdef WITH_MQTT
+#include "MqttClient.h"
+#else
+#include "Endpoints.h"
+#endif
 
 #ifdef WITH_SWEEPER
 #include "Sweeper.h"
+#include "FeedSchedule.h"
+#endif
+
+#ifdef WITH_METRICS
+#include "MetricsServer.h"
 #endif
 
 #include <Arduino.h>
@@ -15,6 +37,26 @@
 
 // -----------------------------------------------------------------------------
 
+// Per-device state. The fleet simulator (sim/) runs many devices
+// in one process, it redefines this as `static thread_local`.
+#ifndef DEVICE_STATE
+#define DEVICE_STATE static
+#endif
+
+// Check for new commands between reports, in seconds (0 = only with reports)
+#ifndef CONTROL_POLL_INTERVAL
+#define CONTROL_POLL_INTERVAL 0
+#endif
+
+// Adaptive report interval, in seconds
+// (without these in config.h, the interval is fixed to SEND_INTERVAL)
+#ifndef SEND_INTERVAL_MIN
+#define SEND_INTERVAL_MIN SEND_INTERVAL
+#endif
+#ifndef SEND_INTERVAL_MAX
+#define SEND_INTERVAL_MAX SEND_INTERVAL
+#endif
+
 #ifdef WITH_RGB
 static const int pin_rgb_red = 15;
 static const int pin_rgb_green = 12;
@@ -22,14 +64,245 @@ static const int pin_rgb_blue = 13;
 #endif
 
 
-static Display display;
-static int timer = 0;
+DEVICE_STATE Display display;
+DEVICE_STATE Arena arena;  // transient data of one send cycle
+DEVICE_STATE int timer = 0;
+DEVICE_STATE AdaptiveInterval schedule(SEND_INTERVAL_MIN, SEND_INTERVAL, SEND_INTERVAL_MAX);
+DEVICE_STATE AlertRules alerts;  // see ALERT_RULES
+DEVICE_STATE unsigned long last_tick = 0;  // millis() of last half-second step
+DEVICE_STATE bool first_half = false;
+
+#ifdef WITH_SWEEPER
+DEVICE_STATE Sweeper sweeper(D6, D2);
+DEVICE_STATE FeedSchedule feed_schedule;
+#endif
+
+DEVICE_STATE int ctl_seq = -1;
+
+#ifdef WITH_UDP_TRANSPORT
+DEVICE_STATE UdpClient udp(display);
+#endif
+
+#ifdef WITH_MQTT
+DEVICE_STATE MqttClient mqtt(display);
+#else
+DEVICE_STATE Endpoints endpoints;  // C&C server instances, see DB_ENDPOINTS
+#endif
+
+
+// Execute one command received from C&C server
+static void run_command(const char* cmd)
+{
+    if (strcmp_P(cmd, PSTR("feed")) == 0 || strncmp_P(cmd, PSTR("feed "), 5) == 0) {
+        // "feed [N]" - N sweeps, default 1, at most 100 (like "schedule ... count=N")
+        long count = 1;
+        if (cmd[4] != '\0') {
+            char* end;
+            count = strtol(cmd + 5, &end, 10);
+            if (end == cmd + 5 || *end != '\0' || count < 1 || count > 100) {
+                LOG_WARN("Bad feed count: %s\n", cmd + 5);
+                return;
+            }
+        }
+        LOG_INFO("Feed! (%ld)\n", count);
+#ifdef WITH_SWEEPER
+        sweeper.sweep(int(count));
+#endif
+    } else if (strncmp_P(cmd, PSTR("schedule "), 9) == 0) {
+        // "schedule <HH:MM[:SS]> [options]" - see FeedSchedule.h
+#ifdef WITH_SWEEPER
+        if (!feed_schedule.command(cmd + 9))
+            LOG_WARN("Bad schedule: %s\n", cmd + 9);
+#endif
+    } else if (strncmp_P(cmd, PSTR("interval "), 9) == 0) {
+        // "interval <min> <max>" - bounds of report interval, in seconds
+        char* end;
+        int min_secs = (int) strtol(cmd + 9, &end, 10);
+        int max_secs = *end ? (int) strtol(end, nullptr, 10) : min_secs;
+        schedule.set_bounds(min_secs, max_secs);
+        LOG_INFO("Interval: %d .. %d\n", min_secs, max_secs);
+    } else if (*cmd != '\0') {
+        LOG_WARN("Unknown command: %s\n", cmd);
+    }
+}
 
+
+// Execute commands received from C&C server, one per line
+static void run_commands(const char* commands)
+{
+    char cmd[64];
+    while (*commands != '\0') {
+        const char* end = strchr(commands, '\n');
+        if (end == nullptr)
+            end = commands + strlen(commands);
+        // copy the line, trimmed (long lines are truncated)
+        while (commands != end && isspace(*commands))
+            ++commands;
+        size_t len = min(size_t(end - commands), sizeof(cmd) - 1);
+        while (len != 0 && isspace(commands[len - 1]))
+            --len;
+        memcpy(cmd, commands, len);
+        cmd[len] = '\0';
+        run_command(cmd);
+        commands = *end ? end + 1 : end;
+    }
 #ifdef WITH_SWEEPER
-static Sweeper sweeper(D6, D2);
+    feed_schedule.commit();
+#endif
+}
+
+
+// Start of the send cycle (Wi-Fi), returns false when offline
+static bool begin_report()
+{
+    arena.reset();
+    digitalWrite(LED_BUILTIN, LOW);
+
+    display.clear();
+    display.drawText(1, F("Conn "));
+    display.display();
+
+    // Need Wi-Fi
+    if (!trace::wifi(WiFi.isConnected()))
+        return false;
+    auto ip = WiFi.localIP();
+    LOG_INFO("Wi-Fi connected, IP address: %u.%u.%u.%u\n", ip[0], ip[1], ip[2], ip[3]);
+
+    display.appendText(F("OK"));
+    display.display();
+    return true;
+}
+
+
+// End of the send cycle which got online. Until a report is delivered,
+// the values stay unreported (a significant change keeps the next attempt
+// at the min interval) and the alerts pending.
+static void reported(bool sent)
+{
+    if (sent) {
+        schedule.restart();
+        alerts.restart();
+    } else
+        alerts.failed();
+    LOG_INFO("\nNext report in %d s\n", schedule.interval());
+}
+
+
+// Database query with values of all sensors, written into the arena
+// as the values come in
+static const char* finish_data(Arena::Writer& data)
+{
+    if (data.overflow())
+        LOG_WARN("* Data truncated, increase ARENA_SIZE\n");
+    const char* result = data.finish();
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+    logger.print(result);  // may be longer than max_message
+#endif
+    return result;
+}
+
+
+#ifndef WITH_MQTT
+// Connect to C&C server, returns URL of the report (nullptr on error)
+static const char* connect_report(HttpClient& client)
+{
+    const char* url = arena.printf_P(PSTR("/report/" DEVICE_NAME "?db=" DB_NAME "&seq=%d"), ctl_seq);
+    if (url == nullptr) {
+        LOG_ERROR("* Error: arena full\n");
+        return nullptr;
+    }
+    if (!endpoints.connect(client)) {
+        display.appendText(F("FAIL"));
+        display.display();
+        return nullptr;
+    }
+    return url;
+}
+
+
+// One request to C&C server: post the data (if any), acknowledge commands
+// applied so far by their seq, receive new commands in the response.
+// The ack is implicit in the next report, so commands are delivered
+// again until a report with their seq gets through (at-least-once).
+//
+// Without `body`, this is the poll between reports: GET /control,
+// conditional on the seq we have - 304 Not Modified while there's nothing new.
+// Returns true when the server took the request (200, or the 304).
+static bool request_commands(HttpClient& client, const char* url, const char* body)
+{
+    // captured by a single reference, so std::function doesn't allocate
+    struct {
+        int seq = -1;
+        bool device_checked = false;
+        Arena::Writer commands {arena};
+    } ctl;
+    auto on_header = [&ctl](const char* name, const char* value) {
+        if (strcmp_P(name, PSTR("X-Seq")) == 0)
+            ctl.seq = atoi(value);
+        else if (strcmp_P(name, PSTR("X-Device")) == 0 && strcmp_P(value, PSTR(DEVICE_NAME)) == 0)
+            ctl.device_checked = true;
+        else
+            LOG_DEBUG("hdr: %s: %s\n", name, value);
+    };
+    auto on_line = [&ctl](const char* line) {
+        ctl.commands.print(line);
+        ctl.commands.print('\n');
+    };
+    int status;
+    if (body != nullptr) {
+        LOG_INFO("* Sending data, checking commands...\n");
+        status = client.post(url, body, strlen(body), on_header, on_line);
+    } else {
+        char etag[16];
+        snprintf_P(etag, sizeof(etag), PSTR("\"%d\""), ctl_seq);
+        client.if_none_match(etag);
+        status = client.query("GET", url, on_header, on_line);
+    }
+    client.stop();
+    endpoints.done(status > 0 && status < 500);
+    const char* commands = ctl.commands.finish();
+    if (body == nullptr && status == 304)
+        return true;
+    LOG_INFO("* Status: %d\n", status);
+
+    if (body != nullptr) {
+        display.appendText(status == 200 ? F("OK") : F("FAIL"));
+        display.display();
+    }
+    if (status != 200)
+        return false;
+
+    if (ctl.seq == -1 || ctl.seq == ctl_seq) {
+        // no commands, or seq already seen
+        return true;
+    }
+    if (!ctl.device_checked) {
+        LOG_ERROR("* Error: device_checked=%d seq=%d\n",
+                  ctl.device_checked, ctl.seq);
+        return true;
+    }
+    ctl_seq = ctl.seq;
+    run_commands(commands);
+    return true;
+}
+
+
+#if CONTROL_POLL_INTERVAL > 0
+// New commands between reports, the next report acknowledges them
+static void poll_control()
+{
+    if (!trace::wifi(WiFi.isConnected()))
+        return;
+    arena.reset();
+    const char* url = arena.printf_P(PSTR("/control/" DEVICE_NAME));
+    HttpClient client(display);
+    if (url == nullptr || !endpoints.connect(client))
+        return;
+    request_commands(client, url, nullptr);
+}
+#endif
 #endif
 
-static int ctl_seq = -1;
 
 void setup()
 {
@@ -37,8 +310,7 @@ void setup()
     Serial.begin(115200);
     while (!Serial)
         ;
-    Serial.println();
-    Serial.println("=== Setup ===");
+    LOG_INFO("\n=== Setup ===\n");
 
     // LED pins
     pinMode(LED_BUILTIN, OUTPUT);
@@ -53,6 +325,11 @@ void setup()
     sweeper.setup();
 #endif
 
+#ifdef WITH_I2C
+    // OLED, SHT30, BMP280 share the bus
+    i2c_bus.begin();
+#endif
+
     Sensor::for_each([](Sensor& sensor) {
         sensor.setup();
     });
@@ -60,31 +337,86 @@ void setup()
     display.begin();
 
     // Setup Wi-Fi
-    Serial.println("--- Wi-Fi ---");
+    LOG_INFO("--- Wi-Fi ---\n");
     WiFi.mode(WIFI_STA);
     WiFi.begin(WIFI_SSID, WIFI_PASS);
     //wifi_set_sleep_type(LIGHT_SLEEP_T);
+    logger.begin();
+    trace::begin();
+#ifdef WITH_SWEEPER
+    feed_schedule.begin();
+#endif
+#ifdef WITH_METRICS
+    metrics.begin();
+#endif
+
+#ifdef WITH_MQTT
+    mqtt.begin([](int seq, const char* commands) {
+        // QoS 1 may deliver the same commands again
+        if (seq == ctl_seq)
+            return;
+        ctl_seq = seq;
+        run_commands(commands);
+    });
+#endif
 
-    Serial.println("=== Loop ===");
+    LOG_INFO("=== Loop ===\n");
+    heap_check::arm();
 }
 
 
 void loop()
 {
-    // Reset LEDs
-    digitalWrite(LED_BUILTIN, HIGH);
-#ifdef WITH_RGB
-    analogWrite(pin_rgb_red, 0);
-    analogWrite(pin_rgb_green, 0);
-    analogWrite(pin_rgb_blue, 0);
+    // Steady state must not allocate (only with CHECK_HEAP)
+    heap_check::verify(logger);
+
+    // Send buffered log to UART / telnet, as much as fits without waiting
+    logger.loop();
+    trace::loop();
+#ifdef WITH_METRICS
+    // Scrapes get the cached values, the sensors are not read
+    metrics.loop();
 #endif
-    delay(500);
 
+    // Display frame goes out in parts, between sensor transactions
+    display.loop();
+
+    // Tasks which must not wait, run on every pass
 #ifdef WITH_SWEEPER
-    if (sweeper.check_button())
+    sweeper.update();
+    if (!sweeper.busy() && sweeper.check_button())
         sweeper.sweep();
+    // Scheduled feeding runs on local clock, not on the next report
+    int feed = feed_schedule.due();
+    if (feed != 0)
+        sweeper.sweep(feed);
 #endif
 
+#ifdef WITH_MQTT
+    // Keep the session alive, receive commands
+    mqtt.loop();
+#endif
+
+    // The rest runs in half-second steps, don't block in between
+    if (millis() - last_tick < 500) {
+        heap_check::Pause pause;
+        delay(5);
+        return;
+    }
+    last_tick = millis();
+    first_half = !first_half;
+
+    if (first_half) {
+        // Reset LEDs
+        digitalWrite(LED_BUILTIN, HIGH);
+#ifdef WITH_RGB
+        analogWrite(pin_rgb_red, 0);
+        analogWrite(pin_rgb_green, 0);
+        analogWrite(pin_rgb_blue, 0);
+#endif
+        return;
+    }
+
     // Present remaining time using RGB diode
     // - The value range is 0 .. 1024 (we use only 0..59)
     // - Each minute, a color is smoothly lighten up
@@ -92,10 +424,9 @@ void loop()
     int t_secs = timer % 60;
     int t_mins = timer / 60;
     if (t_secs == 0) {
-        Serial.print(" ");
-        Serial.println(t_mins);
+        LOG_DEBUG(" %d\n", t_mins);
     } else {
-        Serial.print(".");
+        LOG_DEBUG(".");
 #ifdef WITH_RGB
         int value = t_secs;
         if (t_mins == 1 || t_mins == 2 || t_mins == 4)
@@ -106,138 +437,116 @@ void loop()
             analogWrite(pin_rgb_blue, value);
 #endif
     }
+#if !defined(WITH_MQTT) && CONTROL_POLL_INTERVAL > 0
+    // Before drawing the frame, the connection status doesn't stay on display
+    if (timer != 0 && timer % CONTROL_POLL_INTERVAL == 0 && !schedule.due(timer))
+        poll_control();
+#endif
+
     display.clear();
-    if (WiFi.isConnected()) {
+    if (trace::wifi(WiFi.isConnected())) {
         display.drawWifiIcon();
     }
-    display.drawTimer(SEND_INTERVAL - timer);
+    display.drawTimer(max(schedule.interval() - timer, 0));
 
+    // Each sensor samples the hardware only once per its `period()`,
+    // otherwise it keeps the cached value. The conversions run on their own.
     Sensor::for_each([](Sensor& sensor) {
-        sensor.read();
-        sensor.output_to_display(display);
+        sensor.start();
     });
 
-    display.display();
-    delay(500);
-
-    // Wait N minutes
-    if (timer == SEND_INTERVAL) {
-        // Trigger the action
-        timer = 0;
-        digitalWrite(LED_BUILTIN, LOW);
-    } else {
-        // Not yet
-        timer++;
-        return;
-    }
+    // A report due by the interval (or by a change or alert seen before)
+    // connects while the sensors convert, the values are encoded as they
+    // come in and the request goes out with the last one. A significant
+    // change or a fired alert rule in the new values makes the report due
+    // after them.
+    bool due = schedule.due(timer) || alerts.due();
+    bool online = due && begin_report();
+#ifndef WITH_MQTT
+    HttpClient client(display);
+    const char* url = online ? connect_report(client) : nullptr;
+#endif
 
-    // ------------------------------------------------------------------------
+    Arena::Writer data(arena);
+    Sensor::for_each([due, &data](Sensor& sensor) {
+        sensor.finish();
+        if (due)
+            sensor.output_to_database(data);
+        else
+            sensor.output_to_display(display);
+        sensor.output_values([](const char* measurement, const char* sensor, float value) {
+            schedule.sample(measurement, sensor, value);
+            alerts.sample(measurement, sensor, value);
+        });
+    });
 
-    display.clear();
-    display.drawText(1, "Conn ");
-    display.display();
+    if (!due) {
+        display.display();
+        if (!schedule.due(timer) && !alerts.due()) {
+            // Not yet
+            timer++;
+            return;
+        }
+        online = begin_report();
+#ifndef WITH_MQTT
+        url = online ? connect_report(client) : nullptr;
+#endif
+        Sensor::for_each([&data](Sensor& sensor) {
+            sensor.output_to_database(data);
+        });
+    }
 
-    // Need Wi-Fi
-    if (!WiFi.isConnected())
+    // Trigger the action
+    timer = 0;
+    if (!online)
         return;
-    Serial.print("Wi-Fi connected, IP address: ");
-    Serial.println(WiFi.localIP());
+    alerts.output_to_database(data);
 
-    display.appendText("OK");
-    display.display();
+    // ------------------------------------------------------------------------
 
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+    // Values were read (or kept cached) above
     Sensor::for_each([](Sensor& sensor) {
-        sensor.read();
-        sensor.output_to_stream(Serial);
+        auto age = sensor.read();
+        sensor.output_to_stream(logger);
+        if (age != 0)
+            logger.printf_P(PSTR("  (cached, %lu ms old)\n"), age);
     });
-
-    Serial.println();
-
-    // Contact C&C server
-    HttpClient client(display);
-    if (client.connect(DB_HOST, DB_PORT)) {
-        Serial.println("* Checking commands...");
-
-        int seq = -1;
-        bool device_checked = false;
-        bool cmd_feed = false;
-        auto status = client.query("GET", "/control/" DEVICE_NAME,
-                [&](const String& name, const String& value) {
-                    if (name == "X-Seq")
-                        seq = (int) value.toInt();
-                    else if (name == "X-Device" && value.equals(DEVICE_NAME))
-                        device_checked = true;
-                    else
-                        Serial.printf("hdr: %s: %s\n", name.c_str(), value.c_str());
-                },
-                [&](const String& line) {
-                    if (line == "feed")
-                        cmd_feed = true;
-                    else
-                        Serial.println("line: " + line);
-                });
-        client.stop();
-        Serial.println("* Status: " + String(status));
-        Serial.flush();
-
-        if (status == 200) {
-            if (!device_checked || seq == -1) {
-                Serial.printf("* Error: device_checked=%d seq=%d\n",
-                              device_checked, seq);
-                return;
-            }
-
-            if (ctl_seq != -1 && seq == ctl_seq) {
-                // seq already seen
-                return;
-            }
-            ctl_seq = seq;
-
-            if (cmd_feed) {
-                Serial.println("Feed!");
-#ifdef WITH_SWEEPER
-                sweeper.sweep();
+#ifdef WITH_I2C
+    i2c_bus.report(logger);
+#endif
+#ifndef WITH_MQTT
+    endpoints.report(logger);
+#endif
 #endif
-            }
-
-            if (!client.reconnect())
-                return;
-
-            Serial.println("* Sending ack...");
-            client.query("DELETE", ("/control/" DEVICE_NAME "?seq=" + String(seq)).c_str(),
-                     [&](const String& name, const String& value) {
-                         Serial.printf("hdr: %s=%s", name.c_str(), value.c_str());
-                     },
-                     [](const String& line) {
-                         Serial.println("cnt: " + line);
-                     });
-            client.stop();
-        }
-        Serial.flush();
-
-#ifndef NO_SENSORS
-        // Send values to InfluxDB:
-        if (!client.reconnect())
-            return;
-
-        Serial.println("* Sending data...");
-        String data;
 
-        Sensor::for_each([&data](Sensor& sensor) {
-            sensor.output_to_database(data);
-        });
+    // Data delivered: to the UDP listener, the broker or the server (200)
+    bool sent = false;
 
-        Serial.println(data);
+#if defined(WITH_UDP_TRANSPORT) && !defined(NO_SENSORS)
+    // Send values to InfluxDB UDP listener, don't wait for anything
+    LOG_INFO("* Sending data (UDP)...\n");
+    const char* values = finish_data(data);
+    sent = udp.send(DB_HOST, DB_UDP_PORT, values, strlen(values)) > 0;
+#endif
 
-        client.post("/write?db=" DB_NAME, data);
-        client.stop();
-        display.appendText("OK");
-        display.display();
+#ifdef WITH_MQTT
+#if !defined(NO_SENSORS) && !defined(WITH_UDP_TRANSPORT)
+    // Publish values over the persistent session
+    LOG_INFO("* Publishing data...\n");
+    display.drawText(3, F("Pub "));
+    sent = mqtt.publish(finish_data(data), MQTT_QOS);
+    display.appendText(sent ? F("OK") : F("FAIL"));
+    display.display();
+#endif
+#else
+    if (url != nullptr) {
+#if !defined(NO_SENSORS) && !defined(WITH_UDP_TRANSPORT)
+        sent = request_commands(client, url, finish_data(data));
+#else
+        request_commands(client, url, "");
 #endif
-    } else {
-        client.stop();
-        display.appendText("FAIL");
-        display.display();
-        delay(1000);
     }
+#endif
+    reported(sent);
 }
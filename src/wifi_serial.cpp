@@ -1,48 +1,170 @@
 #include "config.h"
+#include "Rfc2217.h"
 
 #include <ESP8266WiFi.h>
 #include <WiFiClient.h>
+#include <algorithm>
 
+// TCP port 23: raw data, e.g. a terminal or `avrdude -P net:<host>:23`
+// TCP port 2217: RFC 2217, the client also sets baud rate, data format
+//                and DTR/RTS (pyserial: `rfc2217://<host>:2217`)
+// Only one client is served at a time.
+
+#ifndef SERIAL_BAUD
+#define SERIAL_BAUD 115200
+#endif
+
+// Longest wait for the client (or UART) to take data, ms.
+// A stalled client is disconnected, so it doesn't block the bridge.
+#ifndef WRITE_TIMEOUT
+#define WRITE_TIMEOUT 2000
+#endif
+
+// RESET_PIN: AVR reset line (active low), pulsed when the client asserts DTR,
+// like the auto-reset capacitor on Arduino boards. Released as input,
+// the AVR has its own pull-up. For a 5 V target, connect it through
+// a diode (cathode to GPIO) or a transistor.
 
 static WiFiServer server(23);
+static WiFiServer server_rfc2217(2217);
 static WiFiClient client;
+static bool client_rfc2217 = false;
 
+// RFC 2217 escaping may double the data sent to the client
 constexpr size_t buffer_size = 1024;
 static uint8_t buffer[buffer_size];
+static uint8_t escaped[2 * buffer_size];
 
-// The buffer type in read() methods differ...
-char* buffer_for_read(HardwareSerial&) { return (char*) buffer; }
-uint8_t* buffer_for_read(WiFiClient&) { return buffer; }
 
-template <typename TRead, typename TWrite>
-void forward_stream(TRead& rstream, TWrite& wstream)
-{
-    auto avail = (size_t) rstream.available();
-    if (avail > 0 && wstream.availableForWrite() >= avail) {
-        if (avail > buffer_size)
-            avail = buffer_size;
-        size_t bytes_read = rstream.read(buffer_for_read(rstream), avail);
-        size_t bytes_written = 0;
-        while (bytes_read > bytes_written) {
-            bytes_written += wstream.write(buffer + bytes_written,
-                                           bytes_read - bytes_written);
+class SerialPort final: public Rfc2217::Port {
+public:
+    void set_baudrate(uint32_t baudrate) override {
+        Serial.updateBaudRate(baudrate);
+    }
+
+    void set_format(uint8_t data_bits, char parity, uint8_t stop_bits) override {
+        // Bit layout of SerialConfig, see uart.h
+        int config = UART_NB_BIT_5 + ((data_bits - 5) << 2);
+        if (parity == 'E')
+            config |= UART_PARITY_EVEN;
+        else if (parity == 'O')
+            config |= UART_PARITY_ODD;
+        config |= (stop_bits == 2) ? UART_NB_STOP_BIT_2 : UART_NB_STOP_BIT_1;
+        Serial.begin(Serial.baudRate(), (SerialConfig) config);
+    }
+
+    void set_dtr(bool active) override {
+#ifdef RESET_PIN
+        if (active) {
+            pinMode(RESET_PIN, OUTPUT);
+            digitalWrite(RESET_PIN, LOW);
+            delay(1);
+            pinMode(RESET_PIN, INPUT);
         }
+#endif
+    }
+
+    void set_rts(bool active) override {}
+
+    void purge(bool rx, bool tx) override {
+        // rx: data received from the target, waiting in the UART buffer
+        if (rx) {
+            while (Serial.available())
+                Serial.read();
+        }
+        // tx (data from the client) is not buffered here,
+        // it's forwarded to UART immediately
+    }
+};
+
+static SerialPort serial_port;
+static Rfc2217 rfc2217(serial_port);
+
+
+// False when `out` didn't take all of the data in WRITE_TIMEOUT
+static bool write_all(Print& out, const uint8_t* data, size_t length)
+{
+    size_t written = 0;
+    auto start = millis();
+    while (written < length) {
+        written += out.write(data + written, length - written);
+        if (written == length)
+            break;
+        if (millis() - start >= WRITE_TIMEOUT)
+            return false;
+        yield();
+    }
+    return true;
+}
+
+
+static void write_to_client(const uint8_t* data, size_t length)
+{
+    if (!write_all(client, data, length))
+        client.stop();
+}
+
+
+static void send_replies()
+{
+    if (rfc2217.reply_length() != 0) {
+        write_to_client(rfc2217.reply(), rfc2217.reply_length());
+        rfc2217.clear_reply();
     }
 }
 
 
+// Client -> serial, only as much as the UART buffer takes without waiting
+static void forward_from_client()
+{
+    size_t avail = client.available();
+    size_t room = Serial.availableForWrite();
+    if (avail == 0 || room == 0)
+        return;
+    size_t length = client.read(buffer, std::min(std::min(avail, room), buffer_size));
+    if (client_rfc2217) {
+        length = rfc2217.decode(buffer, length);
+        send_replies();
+    }
+    write_all(Serial, buffer, length);
+}
+
+
+// Serial -> client
+static void forward_to_client()
+{
+    size_t avail = Serial.available();
+    size_t room = client.availableForWrite();
+    if (client_rfc2217)
+        room /= 2;  // worst case of escaping
+    if (avail == 0 || room == 0)
+        return;
+    size_t length = Serial.read((char*) buffer, std::min(std::min(avail, room), buffer_size));
+    if (client_rfc2217) {
+        length = Rfc2217::encode(buffer, length, escaped);
+        write_to_client(escaped, length);
+    } else
+        write_to_client(buffer, length);
+}
+
+
 void setup()
 {
     pinMode(LED_BUILTIN, OUTPUT);
 
-    Serial.begin(115200);
+    // STK500 pages are 128 B, but keep whole bursts of the target
+    // while Wi-Fi is busy
+    Serial.setRxBufferSize(buffer_size);
+    Serial.begin(SERIAL_BAUD);
 
     digitalWrite(LED_BUILTIN, LOW);
     WiFi.mode(WIFI_STA);
     WiFi.begin(WIFI_SSID, WIFI_PASS);
     if (WiFi.waitForConnectResult() == WL_CONNECTED) {
         server.begin();
+        server_rfc2217.begin();
     }
+    // Protocols like STK500 are request-response, send each chunk immediately
     WiFiClient::setDefaultNoDelay(true);
     digitalWrite(LED_BUILTIN, HIGH);
 }
@@ -62,11 +184,22 @@ void loop()
     if (client.connected()) {
         // pass data between client and serial
         digitalWrite(LED_BUILTIN, LOW);
-        forward_stream(client, Serial);
-        forward_stream(Serial, client);
+        forward_from_client();
+        forward_to_client();
         digitalWrite(LED_BUILTIN, HIGH);
+    } else if (server_rfc2217.hasClient()) {
+        client = server_rfc2217.available();
+        client_rfc2217 = true;
+        // fresh session starts with default settings
+        Serial.begin(SERIAL_BAUD);
+        rfc2217.begin(SERIAL_BAUD);
+        send_replies();
     } else {
         // wait for a client to connect
         client = server.available();
+        if (client_rfc2217 && client) {
+            client_rfc2217 = false;
+            Serial.begin(SERIAL_BAUD);
+        }
     }
 }